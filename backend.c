@@ -0,0 +1,305 @@
+/* Copyright (c) 2012, Bastien Dejean
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include "bspwm.h"
+#include "backend.h"
+
+static uint32_t x_generate_id(void)
+{
+	return xcb_generate_id(dpy);
+}
+
+static void x_create_window(xcb_window_t win, xcb_window_t parent, xcb_rectangle_t rect, uint16_t class, uint32_t mask, const uint32_t *values)
+{
+	xcb_create_window(dpy, XCB_COPY_FROM_PARENT, win, parent, rect.x, rect.y, rect.width, rect.height, 0, class, XCB_COPY_FROM_PARENT, mask, values);
+}
+
+static void x_destroy_window(xcb_window_t win)
+{
+	xcb_destroy_window(dpy, win);
+}
+
+static void x_configure_window(xcb_window_t win, uint16_t mask, const uint32_t *values)
+{
+	xcb_configure_window(dpy, win, mask, values);
+}
+
+static void x_change_window_attributes(xcb_window_t win, uint32_t mask, const uint32_t *values)
+{
+	xcb_change_window_attributes(dpy, win, mask, values);
+}
+
+static void x_change_property(xcb_window_t win, xcb_atom_t property, xcb_atom_t type, uint8_t format, uint32_t len, const void *data)
+{
+	xcb_change_property(dpy, XCB_PROP_MODE_REPLACE, win, property, type, format, len, data);
+}
+
+static void x_map_window(xcb_window_t win)
+{
+	xcb_map_window(dpy, win);
+}
+
+static void x_unmap_window(xcb_window_t win)
+{
+	xcb_unmap_window(dpy, win);
+}
+
+static void x_set_input_focus(xcb_window_t win)
+{
+	xcb_set_input_focus(dpy, XCB_INPUT_FOCUS_POINTER_ROOT, win, XCB_CURRENT_TIME);
+}
+
+static void x_warp_pointer(int16_t x, int16_t y)
+{
+	xcb_warp_pointer(dpy, XCB_NONE, root, 0, 0, 0, 0, x, y);
+}
+
+static void x_send_event(xcb_window_t win, uint32_t mask, const char *evt)
+{
+	xcb_send_event(dpy, false, win, mask, evt);
+}
+
+static void x_kill_client(xcb_window_t win)
+{
+	xcb_kill_client(dpy, win);
+}
+
+static void x_create_pixmap(uint8_t depth, xcb_pixmap_t pixmap, xcb_drawable_t d, uint16_t width, uint16_t height)
+{
+	xcb_create_pixmap(dpy, depth, pixmap, d, width, height);
+}
+
+static void x_free_pixmap(xcb_pixmap_t pixmap)
+{
+	xcb_free_pixmap(dpy, pixmap);
+}
+
+static void x_create_gc(xcb_gcontext_t gc, xcb_drawable_t d)
+{
+	xcb_create_gc(dpy, gc, d, 0, NULL);
+}
+
+static void x_change_gc(xcb_gcontext_t gc, uint32_t mask, const uint32_t *values)
+{
+	xcb_change_gc(dpy, gc, mask, values);
+}
+
+static void x_free_gc(xcb_gcontext_t gc)
+{
+	xcb_free_gc(dpy, gc);
+}
+
+static void x_poly_fill_rectangle(xcb_drawable_t d, xcb_gcontext_t gc, uint32_t len, const xcb_rectangle_t *rects)
+{
+	xcb_poly_fill_rectangle(dpy, d, gc, len, rects);
+}
+
+static void x_free_colors(xcb_colormap_t cmap, uint32_t len, const uint32_t *pixels)
+{
+	xcb_free_colors(dpy, cmap, 0, len, pixels);
+}
+
+static const backend_t xcb_backend = {
+	x_generate_id,
+	x_create_window,
+	x_destroy_window,
+	x_configure_window,
+	x_change_window_attributes,
+	x_change_property,
+	x_map_window,
+	x_unmap_window,
+	x_set_input_focus,
+	x_warp_pointer,
+	x_send_event,
+	x_kill_client,
+	x_create_pixmap,
+	x_free_pixmap,
+	x_create_gc,
+	x_change_gc,
+	x_free_gc,
+	x_poly_fill_rectangle,
+	x_free_colors
+};
+
+/* The null backend only counts the requests it would have sent. */
+
+static uint32_t null_generate_id(void)
+{
+	static uint32_t last_id = 0;
+	return ++last_id;
+}
+
+static void null_create_window(xcb_window_t win, xcb_window_t parent, xcb_rectangle_t rect, uint16_t class, uint32_t mask, const uint32_t *values)
+{
+	(void) win, (void) parent, (void) rect, (void) class, (void) mask, (void) values;
+	recorded_requests[REQUEST_CREATE_WINDOW]++;
+}
+
+static void null_destroy_window(xcb_window_t win)
+{
+	(void) win;
+	recorded_requests[REQUEST_DESTROY_WINDOW]++;
+}
+
+static void null_configure_window(xcb_window_t win, uint16_t mask, const uint32_t *values)
+{
+	(void) win, (void) mask, (void) values;
+	recorded_requests[REQUEST_CONFIGURE_WINDOW]++;
+}
+
+static void null_change_window_attributes(xcb_window_t win, uint32_t mask, const uint32_t *values)
+{
+	(void) win, (void) mask, (void) values;
+	recorded_requests[REQUEST_CHANGE_WINDOW_ATTRIBUTES]++;
+}
+
+static void null_change_property(xcb_window_t win, xcb_atom_t property, xcb_atom_t type, uint8_t format, uint32_t len, const void *data)
+{
+	(void) win, (void) property, (void) type, (void) format, (void) len, (void) data;
+	recorded_requests[REQUEST_CHANGE_PROPERTY]++;
+}
+
+static void null_map_window(xcb_window_t win)
+{
+	(void) win;
+	recorded_requests[REQUEST_MAP_WINDOW]++;
+}
+
+static void null_unmap_window(xcb_window_t win)
+{
+	(void) win;
+	recorded_requests[REQUEST_UNMAP_WINDOW]++;
+}
+
+static void null_set_input_focus(xcb_window_t win)
+{
+	(void) win;
+	recorded_requests[REQUEST_SET_INPUT_FOCUS]++;
+}
+
+static void null_warp_pointer(int16_t x, int16_t y)
+{
+	(void) x, (void) y;
+	recorded_requests[REQUEST_WARP_POINTER]++;
+}
+
+static void null_send_event(xcb_window_t win, uint32_t mask, const char *evt)
+{
+	(void) win, (void) mask, (void) evt;
+	recorded_requests[REQUEST_SEND_EVENT]++;
+}
+
+static void null_kill_client(xcb_window_t win)
+{
+	(void) win;
+	recorded_requests[REQUEST_KILL_CLIENT]++;
+}
+
+static void null_create_pixmap(uint8_t depth, xcb_pixmap_t pixmap, xcb_drawable_t d, uint16_t width, uint16_t height)
+{
+	(void) depth, (void) pixmap, (void) d, (void) width, (void) height;
+	recorded_requests[REQUEST_CREATE_PIXMAP]++;
+}
+
+static void null_free_pixmap(xcb_pixmap_t pixmap)
+{
+	(void) pixmap;
+	recorded_requests[REQUEST_FREE_PIXMAP]++;
+}
+
+static void null_create_gc(xcb_gcontext_t gc, xcb_drawable_t d)
+{
+	(void) gc, (void) d;
+	recorded_requests[REQUEST_CREATE_GC]++;
+}
+
+static void null_change_gc(xcb_gcontext_t gc, uint32_t mask, const uint32_t *values)
+{
+	(void) gc, (void) mask, (void) values;
+	recorded_requests[REQUEST_CHANGE_GC]++;
+}
+
+static void null_free_gc(xcb_gcontext_t gc)
+{
+	(void) gc;
+	recorded_requests[REQUEST_FREE_GC]++;
+}
+
+static void null_poly_fill_rectangle(xcb_drawable_t d, xcb_gcontext_t gc, uint32_t len, const xcb_rectangle_t *rects)
+{
+	(void) d, (void) gc, (void) len, (void) rects;
+	recorded_requests[REQUEST_POLY_FILL_RECTANGLE]++;
+}
+
+static void null_free_colors(xcb_colormap_t cmap, uint32_t len, const uint32_t *pixels)
+{
+	(void) cmap, (void) len, (void) pixels;
+	recorded_requests[REQUEST_FREE_COLORS]++;
+}
+
+static const backend_t null_backend = {
+	null_generate_id,
+	null_create_window,
+	null_destroy_window,
+	null_configure_window,
+	null_change_window_attributes,
+	null_change_property,
+	null_map_window,
+	null_unmap_window,
+	null_set_input_focus,
+	null_warp_pointer,
+	null_send_event,
+	null_kill_client,
+	null_create_pixmap,
+	null_free_pixmap,
+	null_create_gc,
+	null_change_gc,
+	null_free_gc,
+	null_poly_fill_rectangle,
+	null_free_colors
+};
+
+void use_xcb_backend(void)
+{
+	backend = &xcb_backend;
+}
+
+void use_null_backend(void)
+{
+	backend = &null_backend;
+}
+
+void reset_recorded_requests(void)
+{
+	memset(recorded_requests, 0, sizeof(recorded_requests));
+}
+
+unsigned long total_recorded_requests(void)
+{
+	unsigned long total = 0;
+	for (int i = 0; i < REQUEST_LENGTH; i++)
+		total += recorded_requests[i];
+	return total;
+}
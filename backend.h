@@ -0,0 +1,84 @@
+/* Copyright (c) 2012, Bastien Dejean
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BSPWM_BACKEND_H
+#define BSPWM_BACKEND_H
+
+#include <xcb/xcb.h>
+
+typedef enum {
+	REQUEST_CREATE_WINDOW,
+	REQUEST_DESTROY_WINDOW,
+	REQUEST_CONFIGURE_WINDOW,
+	REQUEST_CHANGE_WINDOW_ATTRIBUTES,
+	REQUEST_CHANGE_PROPERTY,
+	REQUEST_MAP_WINDOW,
+	REQUEST_UNMAP_WINDOW,
+	REQUEST_SET_INPUT_FOCUS,
+	REQUEST_WARP_POINTER,
+	REQUEST_SEND_EVENT,
+	REQUEST_KILL_CLIENT,
+	REQUEST_CREATE_PIXMAP,
+	REQUEST_FREE_PIXMAP,
+	REQUEST_CREATE_GC,
+	REQUEST_CHANGE_GC,
+	REQUEST_FREE_GC,
+	REQUEST_POLY_FILL_RECTANGLE,
+	REQUEST_FREE_COLORS,
+	REQUEST_LENGTH
+} request_kind_t;
+
+/* The X side effects of the window manager: everything that only sends a
+ * request, without waiting for a reply, goes through one of these. */
+typedef struct {
+	uint32_t (*generate_id)(void);
+	void (*create_window)(xcb_window_t win, xcb_window_t parent, xcb_rectangle_t rect, uint16_t class, uint32_t mask, const uint32_t *values);
+	void (*destroy_window)(xcb_window_t win);
+	void (*configure_window)(xcb_window_t win, uint16_t mask, const uint32_t *values);
+	void (*change_window_attributes)(xcb_window_t win, uint32_t mask, const uint32_t *values);
+	void (*change_property)(xcb_window_t win, xcb_atom_t property, xcb_atom_t type, uint8_t format, uint32_t len, const void *data);
+	void (*map_window)(xcb_window_t win);
+	void (*unmap_window)(xcb_window_t win);
+	void (*set_input_focus)(xcb_window_t win);
+	void (*warp_pointer)(int16_t x, int16_t y);
+	void (*send_event)(xcb_window_t win, uint32_t mask, const char *evt);
+	void (*kill_client)(xcb_window_t win);
+	void (*create_pixmap)(uint8_t depth, xcb_pixmap_t pixmap, xcb_drawable_t d, uint16_t width, uint16_t height);
+	void (*free_pixmap)(xcb_pixmap_t pixmap);
+	void (*create_gc)(xcb_gcontext_t gc, xcb_drawable_t d);
+	void (*change_gc)(xcb_gcontext_t gc, uint32_t mask, const uint32_t *values);
+	void (*free_gc)(xcb_gcontext_t gc);
+	void (*poly_fill_rectangle)(xcb_drawable_t d, xcb_gcontext_t gc, uint32_t len, const xcb_rectangle_t *rects);
+	void (*free_colors)(xcb_colormap_t cmap, uint32_t len, const uint32_t *pixels);
+} backend_t;
+
+const backend_t *backend;
+unsigned long recorded_requests[REQUEST_LENGTH];
+
+void use_xcb_backend(void);
+void use_null_backend(void);
+void reset_recorded_requests(void);
+unsigned long total_recorded_requests(void);
+
+#endif
@@ -0,0 +1,257 @@
+/* Copyright (c) 2012, Bastien Dejean
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include "bspwm.h"
+#include "common.h"
+#include "messages.h"
+#include "batch.h"
+
+batch_t *make_batch(int fd)
+{
+	batch_t *b = malloc(sizeof(batch_t));
+	b->prev = b->next = NULL;
+	b->fd = fd;
+	b->len = 0;
+	b->cap = BUFSIZ;
+	b->buf = malloc(b->cap);
+	b->out = NULL;
+	b->out_len = b->out_cap = 0;
+	b->events = EPOLLIN;
+	b->eof = false;
+	b->watch = (watch_t) {WATCH_BATCH, b};
+	return b;
+}
+
+void add_batch(int fd, char *data, size_t len)
+{
+	batch_t *b = make_batch(fd);
+	if (batch_head == NULL) {
+		batch_head = batch_tail = b;
+	} else {
+		batch_tail->next = b;
+		b->prev = batch_tail;
+		batch_tail = b;
+	}
+	int flags = fcntl(fd, F_GETFL);
+	if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1 ||
+	    !watch_fd(fd, b->events, &b->watch) || !feed_batch(b, data, len) ||
+	    !process_batch(b) || !update_batch(b))
+		remove_batch(b);
+}
+
+void remove_batch(batch_t *b)
+{
+	if (b == NULL)
+		return;
+	batch_t *a = b->prev;
+	batch_t *c = b->next;
+	if (a != NULL)
+		a->next = c;
+	if (c != NULL)
+		c->prev = a;
+	if (b == batch_head)
+		batch_head = c;
+	if (b == batch_tail)
+		batch_tail = a;
+	unwatch_fd(b->fd);
+	close(b->fd);
+	free(b->buf);
+	free(b->out);
+	free(b);
+}
+
+void handle_batch(batch_t *b, uint32_t events)
+{
+	if ((events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) && !flush_batch(b)) {
+		remove_batch(b);
+		return;
+	}
+	if ((events & ~EPOLLOUT) && !b->eof && !read_batch(b)) {
+		remove_batch(b);
+		return;
+	}
+	/* Commands held back by a full output buffer. */
+	if (!process_batch(b) || !update_batch(b))
+		remove_batch(b);
+}
+
+bool read_batch(batch_t *b)
+{
+	char data[BUFSIZ];
+	ssize_t nb;
+	while (b->out_len < BATCH_OUT_LIMIT) {
+		nb = recv(b->fd, data, sizeof(data), MSG_DONTWAIT);
+		if (nb == 0) {
+			/* The client shuts its writing side down once every
+			 * command is sent, but it still waits for the replies. */
+			b->eof = true;
+			break;
+		} else if (nb == -1) {
+			if (errno == EINTR)
+				continue;
+			return (errno == EAGAIN || errno == EWOULDBLOCK);
+		}
+		if (!feed_batch(b, data, nb) || !process_batch(b))
+			return false;
+	}
+	return true;
+}
+
+bool feed_batch(batch_t *b, char *data, size_t len)
+{
+	if (b->len + len > b->cap) {
+		size_t cap = b->cap;
+		while (b->len + len > cap)
+			cap *= 2;
+		if (cap > 2 * (BATCH_HEAD_LEN + BATCH_MAX_LEN) + BUFSIZ) {
+			warn("Batch buffer overflow.\n");
+			return false;
+		}
+		char *buf = realloc(b->buf, cap);
+		if (buf == NULL)
+			return false;
+		b->buf = buf;
+		b->cap = cap;
+	}
+	memcpy(b->buf + b->len, data, len);
+	b->len += len;
+	return true;
+}
+
+bool process_batch(batch_t *b)
+{
+	size_t pos = 0;
+	bool valid = true;
+	while (b->len - pos >= BATCH_HEAD_LEN && b->out_len < BATCH_OUT_LIMIT) {
+		uint32_t size;
+		memcpy(&size, b->buf + pos, sizeof(size));
+		size = ntohl(size);
+		if (size > BATCH_MAX_LEN) {
+			warn("Batch message too long.\n");
+			valid = false;
+			break;
+		}
+		if (b->len - pos - BATCH_HEAD_LEN < size)
+			break;
+		char *out = NULL;
+		size_t out_len = 0;
+		FILE *rsp = open_memstream(&out, &out_len);
+		if (rsp == NULL) {
+			valid = false;
+			break;
+		}
+		char *msg = b->buf + pos + BATCH_HEAD_LEN;
+		int ret = (is_subscription(msg, size) ? MSG_FAILURE : handle_message(msg, size, rsp));
+		fclose(rsp);
+		pos += BATCH_HEAD_LEN + size;
+		valid = queue_reply(b, ret, out, out_len);
+		free(out);
+		if (!valid)
+			break;
+	}
+	b->len -= pos;
+	memmove(b->buf, b->buf + pos, b->len);
+	return valid && flush_batch(b);
+}
+
+/* Subscriptions need a connection of their own: the batch replies are
+ * buffered, and the connection goes away with the batch */
+bool is_subscription(char *msg, size_t len)
+{
+	size_t n = strnlen(msg, len);
+	if (n == len || !streq(msg, "control"))
+		return false;
+	for (size_t i = n + 1; i < len; i += n + 1) {
+		n = strnlen(msg + i, len - i);
+		if (n < len - i && streq(msg + i, "--subscribe"))
+			return true;
+	}
+	return false;
+}
+
+bool queue_reply(batch_t *b, int ret, char *data, size_t len)
+{
+	size_t need = b->out_len + 1 + BATCH_HEAD_LEN + len;
+	if (need > b->out_cap) {
+		size_t cap = MAX(b->out_cap, BUFSIZ);
+		while (need > cap)
+			cap *= 2;
+		char *out = realloc(b->out, cap);
+		if (out == NULL)
+			return false;
+		b->out = out;
+		b->out_cap = cap;
+	}
+	uint32_t size = htonl(len);
+	b->out[b->out_len] = ret;
+	memcpy(b->out + b->out_len + 1, &size, sizeof(size));
+	memcpy(b->out + b->out_len + 1 + BATCH_HEAD_LEN, data, len);
+	b->out_len = need;
+	return true;
+}
+
+/* Sends as much of the queued replies as the socket accepts right now. */
+bool flush_batch(batch_t *b)
+{
+	size_t pos = 0;
+	while (pos < b->out_len) {
+		ssize_t nb = send(b->fd, b->out + pos, b->out_len - pos, MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (nb == -1) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			return false;
+		}
+		pos += nb;
+	}
+	b->out_len -= pos;
+	memmove(b->out, b->out + pos, b->out_len);
+	return true;
+}
+
+/* Reads commands only while the replies aren't piling up, and waits for
+ * writability while some are queued. Returns false once the client has sent
+ * everything and got every reply. */
+bool update_batch(batch_t *b)
+{
+	if (b->eof && b->out_len == 0)
+		return false;
+	uint32_t events = (b->eof || b->out_len >= BATCH_OUT_LIMIT ? 0 : EPOLLIN) |
+	                  (b->out_len > 0 ? EPOLLOUT : 0);
+	if (events != b->events) {
+		if (!rewatch_fd(b->fd, events, &b->watch))
+			return false;
+		b->events = events;
+	}
+	return true;
+}
@@ -0,0 +1,375 @@
+/* Copyright (c) 2012, Bastien Dejean
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Synthetic X client driving a running bspwm through one scenario and
+ * reporting the observed latencies along with the number of X requests the
+ * window manager issued per operation (see query --stats). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <xcb/xcb.h>
+#include "../helpers.h"
+#include "../common.h"
+
+#define MAX_WINDOWS     4096
+#define SETTLE_TIMEOUT  10000
+#define POLL_DELAY      5
+#define URGENCY_HINT    (1 << 8)
+
+typedef struct {
+	xcb_window_t win;
+	double stamp;
+	double latency;
+	bool mapped;
+	bool configured;
+} bench_window_t;
+
+xcb_connection_t *dpy;
+xcb_screen_t *screen;
+struct sockaddr_un sock_address;
+bench_window_t windows[MAX_WINDOWS];
+unsigned int num_windows;
+double *samples;
+unsigned int num_samples;
+
+double now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+void sleep_ms(long ms)
+{
+	struct timespec ts = {ms / 1000, (ms % 1000) * 1000000};
+	nanosleep(&ts, NULL);
+}
+
+/* Send a space separated command to bspwm and store its output in rsp.
+ * Returns the status of the command. */
+int send_command(char *cmd, char *rsp, size_t rsp_len)
+{
+	char msg[BUFSIZ];
+	int msg_len = snprintf(msg, sizeof(msg), "%s", cmd) + 1;
+	for (int i = 0; i < msg_len; i++)
+		if (msg[i] == ' ')
+			msg[i] = '\0';
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd == -1)
+		err("Failed to create the socket.\n");
+	if (connect(fd, (struct sockaddr *) &sock_address, sizeof(sock_address)) == -1)
+		err("Failed to connect to the socket.\n");
+	if (send(fd, msg, msg_len, 0) == -1)
+		err("Failed to send the data.\n");
+
+	size_t len = 0;
+	ssize_t nb;
+	char buf[BUFSIZ];
+	while ((nb = recv(fd, buf, sizeof(buf), 0)) > 0) {
+		if (rsp != NULL && len + 1 < rsp_len) {
+			size_t n = MIN((size_t) nb, rsp_len - len - 1);
+			memcpy(rsp + len, buf, n);
+			len += n;
+		}
+	}
+	close(fd);
+
+	int ret = MSG_SUCCESS;
+	if (rsp != NULL) {
+		rsp[len] = '\0';
+		if (len == 1 && rsp[0] < MSG_LENGTH)
+			ret = rsp[0];
+	}
+	return ret;
+}
+
+void reset_stats(void)
+{
+	send_command("control --reset-stats", NULL, 0);
+}
+
+/* Read a counter from the statistics, the line is found by its prefix. */
+unsigned long read_stat(char *prefix, char *field)
+{
+	char rsp[1 << 16], fmt[MAXLEN];
+	unsigned long value = 0;
+	send_command("query --stats", rsp, sizeof(rsp));
+	snprintf(fmt, sizeof(fmt), "%s %%lu", field);
+	size_t len = strlen(prefix);
+	for (char *line = strtok(rsp, "\n"); line != NULL; line = strtok(NULL, "\n")) {
+		if (strncmp(line, prefix, len) != 0)
+			continue;
+		char *f = strstr(line, field);
+		if (f != NULL)
+			sscanf(f, fmt, &value);
+		break;
+	}
+	return value;
+}
+
+/* The window manager leaves out the requests of the statistics queries. */
+double requests_per_op(unsigned int ops)
+{
+	unsigned long requests = read_stat("requests", "requests");
+	return ops > 0 ? (double) requests / ops : 0;
+}
+
+/* Wait until the windows of a previous run are gone and focus the first
+ * desktop. */
+void settle(void)
+{
+	char rsp[BUFSIZ];
+	double start = now_us();
+	while (send_command("query -W", rsp, sizeof(rsp)) == MSG_SUCCESS && rsp[0] != '\0') {
+		if (now_us() - start > SETTLE_TIMEOUT * 1e3)
+			err("Windows from a previous run are still managed.\n");
+		sleep_ms(POLL_DELAY);
+	}
+	send_command("desktop -f ^1", NULL, 0);
+}
+
+bench_window_t *find_window(xcb_window_t win)
+{
+	for (unsigned int i = 0; i < num_windows; i++)
+		if (windows[i].win == win)
+			return &windows[i];
+	return NULL;
+}
+
+bench_window_t *create_window(void)
+{
+	if (num_windows >= MAX_WINDOWS)
+		err("Too many windows.\n");
+	bench_window_t *w = &windows[num_windows++];
+	uint32_t values[] = {XCB_EVENT_MASK_STRUCTURE_NOTIFY};
+	w->win = xcb_generate_id(dpy);
+	w->mapped = w->configured = false;
+	xcb_create_window(dpy, XCB_COPY_FROM_PARENT, w->win, screen->root, 0, 0, 1, 1, 0, XCB_WINDOW_CLASS_INPUT_OUTPUT, XCB_COPY_FROM_PARENT, XCB_CW_EVENT_MASK, values);
+	xcb_change_property(dpy, XCB_PROP_MODE_REPLACE, w->win, XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, 8, sizeof("bench\0Bench"), "bench\0Bench");
+	return w;
+}
+
+void map_window(bench_window_t *w)
+{
+	w->stamp = now_us();
+	xcb_map_window(dpy, w->win);
+}
+
+/* Process the events until the given windows are mapped and were moved away
+ * from their initial geometry. */
+void wait_managed(unsigned int first, unsigned int last)
+{
+	unsigned int pending = last - first;
+	xcb_flush(dpy);
+	while (pending > 0) {
+		xcb_generic_event_t *evt = xcb_wait_for_event(dpy);
+		if (evt == NULL)
+			err("The X server closed the connection.\n");
+		bench_window_t *w = NULL;
+		uint8_t resp_type = evt->response_type & ~0x80;
+		if (resp_type == XCB_MAP_NOTIFY) {
+			w = find_window(((xcb_map_notify_event_t *) evt)->window);
+			if (w != NULL)
+				w->mapped = true;
+		} else if (resp_type == XCB_CONFIGURE_NOTIFY) {
+			w = find_window(((xcb_configure_notify_event_t *) evt)->window);
+			if (w != NULL)
+				w->configured = true;
+		}
+		if (w != NULL && w->mapped && w->configured && w->latency == 0) {
+			w->latency = now_us() - w->stamp;
+			if (w >= &windows[first] && w < &windows[last]) {
+				samples[num_samples++] = w->latency;
+				pending--;
+			}
+		}
+		free(evt);
+	}
+}
+
+void map_windows(unsigned int count)
+{
+	for (unsigned int i = 0; i < count; i++) {
+		bench_window_t *w = create_window();
+		map_window(w);
+		wait_managed(num_windows - 1, num_windows);
+	}
+}
+
+void command_round_trip(char *cmd)
+{
+	double start = now_us();
+	if (send_command(cmd, NULL, 0) != MSG_SUCCESS)
+		warn("Command failed: %s.\n", cmd);
+	samples[num_samples++] = now_us() - start;
+}
+
+int compare_samples(const void *a, const void *b)
+{
+	double x = *(double *) a, y = *(double *) b;
+	return (x > y) - (x < y);
+}
+
+void report(char *name, unsigned int ops, double total, double requests)
+{
+	printf("%-10s ops %5u  total %10.0f us", name, ops, total);
+	if (num_samples > 0) {
+		qsort(samples, num_samples, sizeof(double), compare_samples);
+		double sum = 0;
+		for (unsigned int i = 0; i < num_samples; i++)
+			sum += samples[i];
+		printf("  mean %8.1f  p50 %8.1f  p90 %8.1f  p99 %8.1f  max %8.1f us",
+		       sum / num_samples, samples[num_samples / 2], samples[num_samples * 9 / 10],
+		       samples[num_samples * 99 / 100], samples[num_samples - 1]);
+	}
+	printf("  %6.1f req/op\n", requests);
+}
+
+/* Map the windows one at a time: map to configured latency. */
+void bench_map(unsigned int count)
+{
+	reset_stats();
+	double start = now_us();
+	map_windows(count);
+	report("map", count, now_us() - start, requests_per_op(count));
+}
+
+/* Map all the windows at once. */
+void bench_storm(unsigned int count)
+{
+	for (unsigned int i = 0; i < count; i++)
+		create_window();
+	xcb_flush(dpy);
+	reset_stats();
+	double start = now_us();
+	for (unsigned int i = 0; i < count; i++) {
+		windows[i].stamp = start;
+		xcb_map_window(dpy, windows[i].win);
+	}
+	wait_managed(0, count);
+	report("storm", count, now_us() - start, requests_per_op(count));
+}
+
+/* Toggle the urgency hint of managed windows: the latency is the time spent
+ * by the window manager handling each property notification. */
+void bench_props(unsigned int count, unsigned int rounds)
+{
+	map_windows(count);
+	reset_stats();
+	double start = now_us();
+	for (unsigned int i = 0; i < rounds; i++) {
+		uint32_t hints[9] = {URGENCY_HINT * (i / count % 2)};
+		xcb_change_property(dpy, XCB_PROP_MODE_REPLACE, windows[i % count].win, XCB_ATOM_WM_HINTS, XCB_ATOM_WM_HINTS, 32, LENGTH(hints), hints);
+	}
+	xcb_flush(dpy);
+	while (read_stat("event PropertyNotify", "count") < rounds)
+		sleep_ms(POLL_DELAY);
+	double total = now_us() - start;
+	double handled = read_stat("event PropertyNotify", "total");
+	num_samples = 0;
+	printf("%-10s mean handling time %.1f us\n", "props", handled / rounds);
+	report("props", rounds, total, requests_per_op(rounds));
+}
+
+void bench_focus(unsigned int count, unsigned int rounds)
+{
+	map_windows(count);
+	num_samples = 0;
+	reset_stats();
+	double start = now_us();
+	for (unsigned int i = 0; i < rounds; i++)
+		command_round_trip("window -f next");
+	report("focus", rounds, now_us() - start, requests_per_op(rounds));
+}
+
+/* Fill each desktop of the focused monitor and cycle through them. */
+void bench_desktop(unsigned int count, unsigned int rounds)
+{
+	char rsp[BUFSIZ];
+	unsigned int desktops = 0;
+	send_command("query -D -m", rsp, sizeof(rsp));
+	for (char *s = rsp; *s != '\0'; s++)
+		if (*s == '\n')
+			desktops++;
+	for (unsigned int i = 0; i < desktops; i++) {
+		map_windows(count);
+		send_command("desktop -f next", NULL, 0);
+	}
+	num_samples = 0;
+	reset_stats();
+	double start = now_us();
+	for (unsigned int i = 0; i < rounds; i++)
+		command_round_trip("desktop -f next");
+	report("desktop", rounds, now_us() - start, requests_per_op(rounds));
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+		err("usage: bspwm-bench map|storm|props|focus|desktop [WINDOWS] [ROUNDS]\n");
+
+	unsigned int count = (argc > 2 ? strtoul(argv[2], NULL, 10) : 100);
+	unsigned int rounds = (argc > 3 ? strtoul(argv[3], NULL, 10) : 1000);
+	count = MAX(1, MIN(count, MAX_WINDOWS / 16));
+
+	char *sp = getenv(SOCKET_ENV_VAR);
+	if (sp == NULL)
+		err("The %s environment variable isn't set.\n", SOCKET_ENV_VAR);
+	sock_address.sun_family = AF_UNIX;
+	snprintf(sock_address.sun_path, sizeof(sock_address.sun_path), "%s", sp);
+
+	dpy = xcb_connect(NULL, NULL);
+	if (xcb_connection_has_error(dpy))
+		err("Can't open the display.\n");
+	screen = xcb_setup_roots_iterator(xcb_get_setup(dpy)).data;
+
+	samples = malloc(sizeof(double) * MAX(MAX_WINDOWS, rounds));
+	if (samples == NULL)
+		err("Failed to allocate memory.\n");
+
+	settle();
+
+	if (streq("map", argv[1]))
+		bench_map(count);
+	else if (streq("storm", argv[1]))
+		bench_storm(count);
+	else if (streq("props", argv[1]))
+		bench_props(count, rounds);
+	else if (streq("focus", argv[1]))
+		bench_focus(count, rounds);
+	else if (streq("desktop", argv[1]))
+		bench_desktop(count, rounds);
+	else
+		err("Unknown scenario: %s.\n", argv[1]);
+
+	free(samples);
+	xcb_disconnect(dpy);
+	return EXIT_SUCCESS;
+}
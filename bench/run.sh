@@ -0,0 +1,65 @@
+#!/bin/sh
+#
+# Run the benchmark scenarios against a private Xvfb server.
+#
+# The parameters are fixed so that two runs on the same machine can be
+# compared: BENCH_WINDOWS windows per scenario (per desktop for the desktop
+# scenario) and BENCH_ROUNDS operations for the command and property storms.
+
+cd "$(dirname "$0")/.." || exit 1
+
+display=${BENCH_DISPLAY:-:99}
+windows=${BENCH_WINDOWS:-100}
+rounds=${BENCH_ROUNDS:-1000}
+scenarios=${BENCH_SCENARIOS:-map storm props focus desktop}
+
+tmp=$(mktemp -d) || exit 1
+export BSPWM_SOCKET="$tmp/bspwm-socket"
+export DISPLAY="$display"
+export PATH="$PWD:$PATH"
+
+cleanup() {
+	[ -n "$wm_pid" ] && kill "$wm_pid" 2> /dev/null
+	[ -n "$xvfb_pid" ] && kill "$xvfb_pid" 2> /dev/null
+	wait
+	rm -rf "$tmp"
+}
+trap cleanup EXIT INT TERM
+
+wait_for() {
+	tries=0
+	until "$@" > /dev/null 2>&1 ; do
+		tries=$((tries + 1))
+		if [ $tries -gt 200 ] ; then
+			echo "Timed out waiting for: $*" >&2
+			exit 1
+		fi
+		sleep 0.05
+	done
+}
+
+desktops_ready() {
+	[ "$(bspc query -D 2> /dev/null | wc -l)" -eq 4 ]
+}
+
+Xvfb "$display" -screen 0 1920x1080x24 -nolisten tcp -noreset > "$tmp/xvfb.log" 2>&1 &
+xvfb_pid=$!
+wait_for test -e "/tmp/.X11-unix/X${display#:}"
+
+cat > "$tmp/bspwmrc" <<-'CONFIG'
+	#!/bin/sh
+	bspc config border_width 2
+	bspc config window_gap 6
+	bspc config focus_follows_pointer false
+	bspc monitor -d I II III IV
+CONFIG
+chmod +x "$tmp/bspwmrc"
+
+./bspwm -c "$tmp/bspwmrc" > "$tmp/bspwm.log" 2>&1 &
+wm_pid=$!
+wait_for desktops_ready
+
+echo "bspwm $(./bspwm -v), $windows windows, $rounds rounds"
+for s in $scenarios ; do
+	bench/bspwm-bench "$s" "$windows" "$rounds" || exit 1
+done
@@ -0,0 +1,283 @@
+/* Copyright (c) 2012, Bastien Dejean
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Headless micro-benchmark of the tree operations: the window manager runs
+ * in-process on top of the null backend, which counts the X requests each
+ * operation would have sent. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../bspwm.h"
+#include "../backend.h"
+#include "../desktop.h"
+#include "../ewmh.h"
+#include "../monitor.h"
+#include "../settings.h"
+#include "../tree.h"
+#include "../window.h"
+
+#define DEFAULT_LEAVES  10000
+#define DEFAULT_ROUNDS  1000
+
+typedef struct {
+	node_t *node;
+	desktop_t *desktop;
+} leaf_t;
+
+xcb_screen_t headless_screen;
+leaf_t *leaves;
+unsigned int num_leaves;
+monitor_t *bench_mon;
+desktop_t *bench_desks[2];
+uint32_t rng_state = 2463534242;
+
+uint32_t next_random(void)
+{
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+	return rng_state;
+}
+
+leaf_t *random_leaf(void)
+{
+	return &leaves[next_random() % num_leaves];
+}
+
+double now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/* Everything that would otherwise be read from the X server. */
+void setup_headless(void)
+{
+	init();
+	use_null_backend();
+	load_settings();
+	headless_screen.root = root = backend->generate_id();
+	headless_screen.default_colormap = backend->generate_id();
+	headless_screen.width_in_pixels = screen_width = 1920;
+	headless_screen.height_in_pixels = screen_height = 1080;
+	headless_screen.root_depth = root_depth = 24;
+	screen = &headless_screen;
+	ewmh = calloc(1, sizeof(xcb_ewmh_connection_t));
+	ewmh_dirty = 0;
+	motion_recorder = backend->generate_id();
+	frozen_pointer = make_pointer_state();
+
+	char *cols[] = {
+		focused_border_color, active_border_color, normal_border_color,
+		presel_border_color, urgent_border_color,
+		focused_locked_border_color, active_locked_border_color, normal_locked_border_color,
+		focused_sticky_border_color, active_sticky_border_color, normal_sticky_border_color,
+		focused_private_border_color, active_private_border_color, normal_private_border_color
+	};
+	for (unsigned int i = 0; i < LENGTH(cols); i++)
+		if (find_color(cols[i], screen->default_colormap) == NULL)
+			add_color(cols[i], screen->default_colormap)->valid = true;
+
+	xcb_rectangle_t rect = {0, 0, screen_width, screen_height};
+	bench_mon = add_monitor(rect);
+	for (unsigned int i = 0; i < LENGTH(bench_desks); i++) {
+		bench_desks[i] = make_desktop(NULL);
+		add_desktop(bench_mon, bench_desks[i]);
+	}
+}
+
+void populate(unsigned int count)
+{
+	leaves = malloc(count * sizeof(leaf_t));
+	if (leaves == NULL)
+		err("Failed to allocate memory.\n");
+	desktop_t *d = bench_desks[0];
+	for (unsigned int i = 0; i < count; i++) {
+		node_t *n = make_node();
+		n->client = make_client(backend->generate_id(), border_width);
+		n->client->floating_rectangle = n->client->tiled_rectangle = (xcb_rectangle_t) {0, 0, 64, 64};
+		insert_node(bench_mon, d, n, num_leaves > 0 ? random_leaf()->node : NULL);
+		leaves[num_leaves++] = (leaf_t) {n, d};
+		num_clients++;
+	}
+	arrange(bench_mon, d);
+	commit_changes();
+}
+
+void op_insert(void)
+{
+	leaf_t *a = random_leaf(), *b = random_leaf();
+	if (a == b || a->desktop != b->desktop)
+		return;
+	unlink_node(bench_mon, a->desktop, a->node);
+	insert_node(bench_mon, b->desktop, a->node, b->node);
+	arrange(bench_mon, a->desktop);
+}
+
+void op_presel(void)
+{
+	leaf_t *a = random_leaf(), *b = random_leaf();
+	if (a == b || a->desktop != b->desktop)
+		return;
+	unlink_node(bench_mon, a->desktop, a->node);
+	b->node->split_mode = MODE_MANUAL;
+	b->node->split_dir = next_random() % 4;
+	insert_node(bench_mon, b->desktop, a->node, b->node);
+	arrange(bench_mon, a->desktop);
+}
+
+void op_swap(void)
+{
+	leaf_t *a = random_leaf(), *b = random_leaf();
+	if (swap_nodes(bench_mon, a->desktop, a->node, bench_mon, b->desktop, b->node)) {
+		desktop_t *d = a->desktop;
+		a->desktop = b->desktop;
+		b->desktop = d;
+		arrange(bench_mon, a->desktop);
+		if (a->desktop != b->desktop)
+			arrange(bench_mon, b->desktop);
+	}
+}
+
+void op_transfer(void)
+{
+	leaf_t *a = random_leaf();
+	desktop_t *d = (a->desktop == bench_desks[0] ? bench_desks[1] : bench_desks[0]);
+	if (transfer_node(bench_mon, a->desktop, a->node, bench_mon, d, d->focus))
+		a->desktop = d;
+}
+
+void op_rotate(void)
+{
+	desktop_t *d = bench_desks[0];
+	rotate_tree(d->root, 90);
+	arrange(bench_mon, d);
+}
+
+void op_balance(void)
+{
+	desktop_t *d = bench_desks[0];
+	balance_tree(d->root);
+	arrange(bench_mon, d);
+}
+
+unsigned int count_nodes(node_t *n)
+{
+	if (n == NULL)
+		return 0;
+	return 1 + count_nodes(n->first_child) + count_nodes(n->second_child);
+}
+
+bool same_rectangle(xcb_rectangle_t a, xcb_rectangle_t b)
+{
+	return (a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height);
+}
+
+/* Records or, if `check` is set, compares the geometry of the subtree in
+ * preorder. Returns the number of differences. */
+unsigned int walk_layout(node_t *n, xcb_rectangle_t **rects, bool check)
+{
+	if (n == NULL)
+		return 0;
+	unsigned int diff = 0;
+	xcb_rectangle_t r = (n->client != NULL ? n->client->tiled_rectangle : n->rectangle);
+	if (check)
+		diff += !same_rectangle(**rects, n->rectangle) || !same_rectangle((*rects)[1], r);
+	else
+		(*rects)[0] = n->rectangle, (*rects)[1] = r;
+	*rects += 2;
+	diff += walk_layout(n->first_child, rects, check);
+	diff += walk_layout(n->second_child, rects, check);
+	return diff;
+}
+
+/* Lay every desktop out again from scratch: the incremental layout must
+ * have produced the exact same geometry. */
+unsigned int check_layouts(void)
+{
+	unsigned int diff = 0;
+	for (unsigned int i = 0; i < LENGTH(bench_desks); i++) {
+		desktop_t *d = bench_desks[i];
+		if (d->root == NULL)
+			continue;
+		xcb_rectangle_t *snapshot = malloc(2 * count_nodes(d->root) * sizeof(xcb_rectangle_t));
+		if (snapshot == NULL)
+			err("Failed to allocate memory.\n");
+		xcb_rectangle_t *rects = snapshot;
+		walk_layout(d->root, &rects, false);
+		invalidate_tree(d->root);
+		arrange(bench_mon, d);
+		commit_changes();
+		rects = snapshot;
+		diff += walk_layout(d->root, &rects, true);
+		free(snapshot);
+	}
+	return diff;
+}
+
+/* Time the operation and the commit of its side effects separately. */
+void run(char *name, void (*op)(void), unsigned int rounds)
+{
+	double op_time = 0, commit_time = 0;
+	reset_recorded_requests();
+	for (unsigned int i = 0; i < rounds; i++) {
+		double start = now_us();
+		op();
+		double mid = now_us();
+		commit_changes();
+		commit_time += now_us() - mid;
+		op_time += mid - start;
+	}
+	printf("%-10s rounds %6u  op %10.2f us  commit %10.2f us  %8.1f req/op\n",
+	       name, rounds, op_time / rounds, commit_time / rounds, (double) total_recorded_requests() / rounds);
+	unsigned int diff = check_layouts();
+	if (diff > 0)
+		err("%s: %u nodes differ from a full layout.\n", name, diff);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int count = (argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_LEAVES);
+	unsigned int rounds = (argc > 2 ? strtoul(argv[2], NULL, 10) : DEFAULT_ROUNDS);
+	count = MAX(2, count);
+
+	setup_headless();
+
+	reset_recorded_requests();
+	double start = now_us();
+	populate(count);
+	printf("%-10s leaves %6u  total %10.0f us  %8.1f req/leaf\n", "populate", count, now_us() - start, (double) total_recorded_requests() / count);
+
+	run("insert", op_insert, rounds);
+	run("presel", op_presel, rounds);
+	run("swap", op_swap, rounds);
+	run("transfer", op_transfer, rounds);
+	run("rotate", op_rotate, rounds);
+	run("balance", op_balance, rounds);
+
+	return EXIT_SUCCESS;
+}
@@ -23,16 +23,211 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
 #ifdef __OpenBSD__
 #include <sys/types.h>
 #endif
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <arpa/inet.h>
 #include <unistd.h>
 #include <ctype.h>
 #include "helpers.h"
 #include "common.h"
 
+#define BATCH_SEP  ";"
+
+typedef struct {
+	int fd;
+	char *out;
+	size_t out_len;
+	size_t out_cap;
+	char *in;
+	size_t in_len;
+	size_t in_cap;
+	unsigned int *origins;			/* line or position of each command sent */
+	size_t origins_cap;
+	bool from_stdin;
+	unsigned int sent;
+	unsigned int received;
+	int ret;
+} batch_state_t;
+
+void reserve(char **buf, size_t *cap, size_t len)
+{
+	if (len <= *cap)
+		return;
+	size_t c = (*cap > 0 ? *cap : BUFSIZ);
+	while (c < len)
+		c *= 2;
+	if ((*buf = realloc(*buf, c)) == NULL)
+		err("Failed to allocate memory.\n");
+	*cap = c;
+}
+
+void report_status(batch_state_t *st, unsigned int origin, int status)
+{
+	char *unit = (st->from_stdin ? "Line" : "Command");
+	if (status == MSG_UNKNOWN)
+		warn("%s %u: unknown command.\n", unit, origin);
+	else if (status == MSG_SYNTAX)
+		warn("%s %u: invalid syntax.\n", unit, origin);
+	else if (status != MSG_SUCCESS)
+		warn("%s %u: failure.\n", unit, origin);
+}
+
+int receive_replies(batch_state_t *st, bool wait)
+{
+	reserve(&st->in, &st->in_cap, st->in_len + BUFSIZ);
+	ssize_t nb = recv(st->fd, st->in + st->in_len, BUFSIZ, wait ? 0 : MSG_DONTWAIT);
+	if (nb == 0)
+		return 0;
+	if (nb == -1)
+		return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 1 : -1;
+	st->in_len += nb;
+	size_t pos = 0;
+	while (st->in_len - pos >= 1 + BATCH_HEAD_LEN) {
+		uint32_t size;
+		memcpy(&size, st->in + pos + 1, sizeof(size));
+		size = ntohl(size);
+		if (st->in_len - pos - 1 - BATCH_HEAD_LEN < size)
+			break;
+		int status = st->in[pos];
+		fwrite(st->in + pos + 1 + BATCH_HEAD_LEN, 1, size, stdout);
+		fflush(stdout);
+		report_status(st, st->origins[st->received++], status);
+		if (status != MSG_SUCCESS && st->ret == MSG_SUCCESS)
+			st->ret = status;
+		pos += 1 + BATCH_HEAD_LEN + size;
+	}
+	st->in_len -= pos;
+	memmove(st->in, st->in + pos, st->in_len);
+	return 1;
+}
+
+/* Send what can be sent and print the replies that already arrived. Unless
+ * drain is set, only block when the outgoing buffer is getting large. */
+void pump(batch_state_t *st, bool drain)
+{
+	while (true) {
+		bool block = (drain ? st->out_len > 0 : st->out_len > BUFSIZ);
+		struct pollfd pfd = {st->fd, POLLIN | (st->out_len > 0 ? POLLOUT : 0), 0};
+		if (poll(&pfd, 1, block ? -1 : 0) == -1) {
+			if (errno == EINTR)
+				continue;
+			err("Failed to poll the socket.\n");
+		}
+		if (pfd.revents & POLLOUT) {
+			ssize_t nb = send(st->fd, st->out, st->out_len, MSG_DONTWAIT);
+			if (nb == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+				err("Failed to send the data.\n");
+			if (nb > 0) {
+				st->out_len -= nb;
+				memmove(st->out, st->out + nb, st->out_len);
+			}
+		}
+		if ((pfd.revents & (POLLIN | POLLHUP | POLLERR)) && receive_replies(st, false) < 1)
+			err("The server closed the connection.\n");
+		if (!block)
+			return;
+	}
+}
+
+/* Queues the given command, found at the given line of the standard input
+ * or position among the arguments */
+void queue_command(batch_state_t *st, char **words, int num, unsigned int origin)
+{
+	size_t len = 0;
+	for (int i = 0; i < num; i++)
+		len += strlen(words[i]) + 1;
+	if (len > BATCH_MAX_LEN) {
+		warn("%s %u: command too long.\n", st->from_stdin ? "Line" : "Command", origin);
+		st->ret = MSG_FAILURE;
+		return;
+	}
+	if (st->sent == st->origins_cap) {
+		st->origins_cap = (st->origins_cap == 0 ? 64 : 2 * st->origins_cap);
+		if ((st->origins = realloc(st->origins, st->origins_cap * sizeof(unsigned int))) == NULL)
+			err("Failed to allocate memory.\n");
+	}
+	st->origins[st->sent] = origin;
+	reserve(&st->out, &st->out_cap, st->out_len + BATCH_HEAD_LEN + len);
+	uint32_t size = htonl(len);
+	memcpy(st->out + st->out_len, &size, sizeof(size));
+	st->out_len += BATCH_HEAD_LEN;
+	for (int i = 0; i < num; i++) {
+		size_t n = strlen(words[i]) + 1;
+		memcpy(st->out + st->out_len, words[i], n);
+		st->out_len += n;
+	}
+	st->sent++;
+	pump(st, false);
+}
+
+int run_batch(int fd, int argc, char *argv[])
+{
+	batch_state_t st = {0};
+	st.fd = fd;
+	reserve(&st.out, &st.out_cap, sizeof(BATCH_MSG));
+	memcpy(st.out, BATCH_MSG, sizeof(BATCH_MSG));
+	st.out_len = sizeof(BATCH_MSG);
+
+	if (argc > 0) {
+		unsigned int pos = 0;
+		while (argc > 0) {
+			int n = 0;
+			while (n < argc && !streq(BATCH_SEP, argv[n]))
+				n++;
+			pos++;
+			if (n > 0)
+				queue_command(&st, argv, n, pos);
+			argc -= n, argv += n;
+			if (argc > 0)
+				argc--, argv++;
+		}
+	} else {
+		char *line = NULL, *words[MAXLEN];
+		size_t cap = 0;
+		unsigned int num = 0;
+		st.from_stdin = true;
+		while (getline(&line, &cap, stdin) != -1) {
+			num++;
+			int n = split_words(line, words, LENGTH(words));
+			if (n < 0) {
+				warn("Line %u: invalid line: %s", num, line);
+				st.ret = MSG_SYNTAX;
+			} else if (n > 0) {
+				queue_command(&st, words, n, num);
+			}
+		}
+		free(line);
+	}
+
+	pump(&st, true);
+	shutdown(fd, SHUT_WR);
+
+	while (st.received < st.sent) {
+		int r = receive_replies(&st, true);
+		if (r == 0)
+			break;
+		else if (r == -1)
+			err("Failed to receive the data.\n");
+	}
+
+	if (st.received < st.sent) {
+		warn("The server closed the connection.\n");
+		st.ret = MSG_FAILURE;
+	}
+
+	free(st.out);
+	free(st.in);
+	free(st.origins);
+	close(fd);
+	return st.ret;
+}
+
 int main(int argc, char *argv[])
 {
 	int fd;
@@ -63,6 +258,10 @@ int main(int argc, char *argv[])
 		err("Failed to connect to the socket.\n");
 
 	argc--, argv++;
+
+	if (streq(BATCH_MSG, *argv))
+		return run_batch(fd, --argc, ++argv);
+
 	int msg_len = 0;
 
 	for (int offset = 0, rem = sizeof(msg), n = 0; argc > 0 && rem > 0; offset += n, rem -= n, argc--, argv++) {
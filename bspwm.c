@@ -25,17 +25,18 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/select.h>
-#ifdef __OpenBSD__
+#include <errno.h>
 #include <sys/types.h>
-#endif
 #include <sys/wait.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
 #include <signal.h>
 #include <unistd.h>
 #include <xcb/xinerama.h>
 #include "types.h"
+#include "backend.h"
 #include "desktop.h"
 #include "monitor.h"
 #include "settings.h"
@@ -48,23 +49,28 @@
 #include "stack.h"
 #include "ewmh.h"
 #include "rule.h"
+#include "tree.h"
+#include "batch.h"
+#include "lookup.h"
+#include "wintable.h"
+#include "stats.h"
 #include "bspwm.h"
 
 int main(int argc, char *argv[])
 {
-	fd_set descriptors;
+	struct epoll_event events[MAX_EVENTS];
 	char socket_path[MAXLEN];
 	config_path[0] = '\0';
-	int sock_fd, cli_fd, dpy_fd, max_fd, n;
+	declarations_path[0] = '\0';
+	int sock_fd, cli_fd, dpy_fd, sig_fd, nfds, n;
 	struct sockaddr_un sock_address;
 	char msg[BUFSIZ] = {0};
-	xcb_generic_event_t *event;
 	char opt;
 
-	while ((opt = getopt(argc, argv, "hvc:")) != (char)-1) {
+	while ((opt = getopt(argc, argv, "hvc:d:")) != (char)-1) {
 		switch (opt) {
 			case 'h':
-				printf(WM_NAME " [-h|-v|-c CONFIG_PATH]\n");
+				printf(WM_NAME " [-h|-v|-c CONFIG_PATH|-d DECLARATIONS_PATH]\n");
 				exit(EXIT_SUCCESS);
 				break;
 			case 'v':
@@ -74,6 +80,9 @@ int main(int argc, char *argv[])
 			case 'c':
 				snprintf(config_path, sizeof(config_path), "%s", optarg);
 				break;
+			case 'd':
+				snprintf(declarations_path, sizeof(declarations_path), "%s", optarg);
+				break;
 		}
 	}
 
@@ -91,7 +100,7 @@ int main(int argc, char *argv[])
 	sock_address.sun_family = AF_UNIX;
 	snprintf(sock_address.sun_path, sizeof(sock_address.sun_path), "%s", socket_path);
 
-	sock_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	sock_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
 
 	if (sock_fd == -1)
 		err("Couldn't create the socket.\n");
@@ -111,53 +120,104 @@ int main(int argc, char *argv[])
 			snprintf(config_path, sizeof(config_path), "%s/%s/%s/%s", getenv("HOME"), ".config", WM_NAME, CONFIG_NAME);
 	}
 
+	if (declarations_path[0] == '\0') {
+		char *config_home = getenv(CONFIG_HOME_ENV);
+		if (config_home != NULL)
+			snprintf(declarations_path, sizeof(declarations_path), "%s/%s/%s", config_home, WM_NAME, DECLARATIONS_NAME);
+		else
+			snprintf(declarations_path, sizeof(declarations_path), "%s/%s/%s/%s", getenv("HOME"), ".config", WM_NAME, DECLARATIONS_NAME);
+	}
+
 	dpy = xcb_connect(NULL, &default_screen);
 
 	if (!check_connection(dpy))
 		exit(EXIT_FAILURE);
 
+	evt_fd = epoll_create1(EPOLL_CLOEXEC);
+
+	if (evt_fd == -1)
+		err("Couldn't create the event queue.\n");
+
+	sigemptyset(&blocked_signals);
+	sigaddset(&blocked_signals, SIGINT);
+	sigaddset(&blocked_signals, SIGHUP);
+	sigaddset(&blocked_signals, SIGTERM);
+	sigaddset(&blocked_signals, SIGCHLD);
+	sigprocmask(SIG_BLOCK, &blocked_signals, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	sig_fd = signalfd(-1, &blocked_signals, SFD_NONBLOCK | SFD_CLOEXEC);
+
+	if (sig_fd == -1)
+		err("Couldn't create the signal descriptor.\n");
+
 	load_settings();
 	setup();
 
 	dpy_fd = xcb_get_file_descriptor(dpy);
 
-	signal(SIGINT, sig_handler);
-	signal(SIGHUP, sig_handler);
-	signal(SIGTERM, sig_handler);
-	signal(SIGCHLD, sig_handler);
-	signal(SIGPIPE, SIG_IGN);
+	watch_t dpy_watch = {WATCH_DISPLAY, NULL};
+	watch_t sock_watch = {WATCH_SOCKET, NULL};
+	watch_t sig_watch = {WATCH_SIGNAL, NULL};
+	if (!watch_fd(dpy_fd, EPOLLIN, &dpy_watch) ||
+	    !watch_fd(sock_fd, EPOLLIN, &sock_watch) ||
+	    !watch_fd(sig_fd, EPOLLIN, &sig_watch))
+		err("Couldn't register the main descriptors.\n");
+
+	load_declarations();
 	run_config();
 	running = true;
 
 	while (running) {
 
+		expire_pending_rules();
+		run_queued_rules();
+		commit_changes();
+		flush_report();
 		xcb_flush(dpy);
 
-		FD_ZERO(&descriptors);
-		FD_SET(sock_fd, &descriptors);
-		FD_SET(dpy_fd, &descriptors);
-		max_fd = MAX(sock_fd, dpy_fd);
-		for (pending_rule_t *pr = pending_rule_head; pr != NULL; pr = pr->next) {
-			FD_SET(pr->fd, &descriptors);
-			if (pr->fd > max_fd)
-				max_fd = pr->fd;
+		nfds = epoll_wait(evt_fd, events, LENGTH(events), next_rule_timeout());
+
+		if (nfds == -1 && errno != EINTR) {
+			warn("Couldn't wait for events.\n");
+			running = false;
 		}
 
-		if (select(max_fd + 1, &descriptors, NULL, NULL, NULL) > 0) {
+		/* Subscribers and pending rules can be freed while handling the other
+		 * kinds of events: deal with them first, in that order, so that no
+		 * handler ever sees a stale pointer from this batch. */
+		for (int i = 0; i < nfds; i++) {
+			watch_t *w = events[i].data.ptr;
+			if (w->kind == WATCH_SUBSCRIBER) {
+				if ((events[i].events & EPOLLOUT) && !flush_subscriber(w->data))
+					continue;
+				if (events[i].events & ~EPOLLOUT)
+					drain_subscriber(w->data);
+			}
+		}
 
-			pending_rule_t *pr = pending_rule_head;
-			while (pr != NULL) {
-				pending_rule_t *next = pr->next;
-				if (FD_ISSET(pr->fd, &descriptors)) {
-					manage_window(pr->win, pr->csq, pr->fd);
-					remove_pending_rule(pr);
-				}
-				pr = next;
+		for (int i = 0; i < nfds; i++) {
+			watch_t *w = events[i].data.ptr;
+			if (w->kind == WATCH_RULE) {
+				read_pending_rule(w->data);
+			} else if (w->kind == WATCH_COPROCESS) {
+				read_rule_coprocess();
 			}
+		}
 
-			if (FD_ISSET(sock_fd, &descriptors)) {
+		for (int i = 0; i < nfds; i++) {
+			watch_t *w = events[i].data.ptr;
+			if (w->kind == WATCH_SIGNAL) {
+				struct signalfd_siginfo si;
+				while (read(sig_fd, &si, sizeof(si)) == sizeof(si))
+					sig_handler(si.ssi_signo);
+			} else if (w->kind == WATCH_SOCKET) {
 				cli_fd = accept(sock_fd, NULL, 0);
 				if (cli_fd > 0 && (n = recv(cli_fd, msg, sizeof(msg), 0)) > 0) {
+					if (n >= (int) sizeof(BATCH_MSG) && memcmp(msg, BATCH_MSG, sizeof(BATCH_MSG)) == 0) {
+						add_batch(cli_fd, msg + sizeof(BATCH_MSG), n - sizeof(BATCH_MSG));
+						continue;
+					}
 					msg[n] = '\0';
 					FILE *rsp = fdopen(cli_fd, "w");
 					if (rsp != NULL) {
@@ -173,14 +233,15 @@ int main(int argc, char *argv[])
 						close(cli_fd);
 					}
 				}
+			} else if (w->kind == WATCH_BATCH) {
+				handle_batch(w->data, events[i].events);
 			}
+		}
 
-			if (FD_ISSET(dpy_fd, &descriptors)) {
-				while ((event = xcb_poll_for_event(dpy)) != NULL) {
-					handle_event(event);
-					free(event);
-				}
-			}
+		for (int i = 0; i < nfds; i++) {
+			watch_t *w = events[i].data.ptr;
+			if (w->kind == WATCH_DISPLAY)
+				handle_events();
 		}
 
 		if (!check_connection(dpy))
@@ -188,6 +249,8 @@ int main(int argc, char *argv[])
 	}
 
 	cleanup();
+	close(sig_fd);
+	close(evt_fd);
 	close(sock_fd);
 	unlink(socket_path);
 	xcb_ewmh_connection_wipe(ewmh);
@@ -201,14 +264,47 @@ int main(int argc, char *argv[])
 
 void init(void)
 {
+	use_xcb_backend();
 	num_monitors = num_desktops = num_clients = 0;
 	monitor_uid = desktop_uid = 0;
 	mon = mon_head = mon_tail = pri_mon = NULL;
 	history_head = history_tail = history_needle = NULL;
+	history_count = history_stamp = 0;
+	history_limit = HISTORY_MAX;
 	rule_head = rule_tail = NULL;
-	stack_head = stack_tail = NULL;
+	rule_order = 0;
+	rule_table = NULL;
+	rule_table_size = rule_table_count = 0;
+	for (int l = 0; l < LAYER_LENGTH; l++)
+		stack_head[l] = stack_tail[l] = NULL;
+	dirty_stack = NULL;
+	dirty_stack_len = dirty_stack_cap = 0;
+	dirty_borders = NULL;
+	dirty_borders_len = dirty_borders_cap = 0;
 	subscribe_head = subscribe_tail = NULL;
+	subscribe_overflows = 0;
+	report_dirty = false;
+	batch_head = batch_tail = NULL;
 	pending_rule_head = pending_rule_tail = NULL;
+	queued_rule_head = queued_rule_tail = NULL;
+	running_rules = 0;
+	rule_coprocess.pid = 0;
+	rule_coprocess.in = rule_coprocess.out = -1;
+	rule_coprocess.last_id = 0;
+	rule_coprocess.len = 0;
+	rule_coprocess.watch = (watch_t) {WATCH_COPROCESS, NULL};
+	prefetch_head = prefetch_tail = NULL;
+	color_head = NULL;
+	gc_head = NULL;
+	wintable = NULL;
+	wintable_size = wintable_count = 0;
+	monitor_list = NULL;
+	desktop_list = NULL;
+	monitor_table = NULL;
+	desktop_table = NULL;
+	monitor_count = desktop_count = 0;
+	monitor_table_size = desktop_table_size = 0;
+	lookup_stale = true;
 	last_motion_time = last_motion_x = last_motion_y = 0;
 	visible = auto_raise = sticky_still = record_history = true;
 	randr_base = 0;
@@ -307,11 +403,13 @@ void setup(void)
 	ewmh_update_number_of_desktops();
 	ewmh_update_desktop_names();
 	ewmh_update_current_desktop();
+	cache_border_colors(screen->default_colormap);
 	frozen_pointer = make_pointer_state();
 	xcb_get_input_focus_reply_t *ifo = xcb_get_input_focus_reply(dpy, xcb_get_input_focus(dpy), NULL);
 	if (ifo != NULL && (ifo->focus == XCB_INPUT_FOCUS_POINTER_ROOT || ifo->focus == XCB_NONE))
 		clear_input_focus();
 	free(ifo);
+	reset_stats();
 }
 
 void register_events(void)
@@ -330,16 +428,44 @@ void cleanup(void)
 		remove_monitor(mon_head);
 	while (rule_head != NULL)
 		remove_rule(rule_head);
-	while (stack_head != NULL)
-		remove_stack(stack_head);
+	free(rule_table);
+	for (int l = 0; l < LAYER_LENGTH; l++)
+		while (stack_head[l] != NULL)
+			remove_stack(stack_head[l]);
 	while (subscribe_head != NULL)
 		remove_subscriber(subscribe_head);
+	while (batch_head != NULL)
+		remove_batch(batch_head);
 	while (pending_rule_head != NULL)
 		remove_pending_rule(pending_rule_head);
+	while (queued_rule_head != NULL)
+		remove_pending_rule(queued_rule_head);
+	stop_rule_coprocess();
+	while (prefetch_head != NULL)
+		remove_prefetch(prefetch_head);
+	empty_wintable();
+	empty_lookup();
+	empty_colors();
+	empty_gcs();
 	empty_history();
+	free(dirty_stack);
+	free(dirty_borders);
 	free(frozen_pointer);
 }
 
+/* Push the changes accumulated while handling the last batch of events and
+ * messages: each dirty desktop is arranged once, each border drawn once. */
+void commit_changes(void)
+{
+	for (monitor_t *m = mon_head; m != NULL; m = m->next)
+		for (desktop_t *d = m->desk_head; d != NULL; d = d->next)
+			if (d->dirty)
+				commit_arrange(m, d);
+	commit_borders();
+	commit_stack();
+	ewmh_commit();
+}
+
 bool check_connection (xcb_connection_t *dpy)
 {
 	int xerr;
@@ -377,10 +503,36 @@ bool check_connection (xcb_connection_t *dpy)
 	}
 }
 
+bool watch_fd(int fd, uint32_t events, watch_t *w)
+{
+	struct epoll_event ev = {.events = events, .data.ptr = w};
+	if (epoll_ctl(evt_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+		warn("Couldn't watch descriptor %i.\n", fd);
+		return false;
+	}
+	return true;
+}
+
+bool rewatch_fd(int fd, uint32_t events, watch_t *w)
+{
+	struct epoll_event ev = {.events = events, .data.ptr = w};
+	return (epoll_ctl(evt_fd, EPOLL_CTL_MOD, fd, &ev) != -1);
+}
+
+void unwatch_fd(int fd)
+{
+	struct epoll_event ev = {0};
+	epoll_ctl(evt_fd, EPOLL_CTL_DEL, fd, &ev);
+}
+
+void restore_signals(void)
+{
+	sigprocmask(SIG_UNBLOCK, &blocked_signals, NULL);
+}
+
 void sig_handler(int sig)
 {
 	if (sig == SIGCHLD) {
-		signal(sig, sig_handler);
 		while (waitpid(-1, 0, WNOHANG) > 0)
 			;
 	} else if (sig == SIGINT || sig == SIGHUP || sig == SIGTERM) {
@@ -25,10 +25,12 @@
 #ifndef BSPWM_BSPWM_H
 #define BSPWM_BSPWM_H
 
+#include <signal.h>
 #include "types.h"
 
 #define ROOT_EVENT_MASK     (XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT | XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY)
 #define CLIENT_EVENT_MASK   (XCB_EVENT_MASK_PROPERTY_CHANGE | XCB_EVENT_MASK_FOCUS_CHANGE)
+#define MAX_EVENTS          64
 
 xcb_connection_t *dpy;
 int default_screen, screen_width, screen_height;
@@ -41,6 +43,9 @@ xcb_screen_t *screen;
 xcb_window_t root;
 uint8_t root_depth;
 char config_path[MAXLEN];
+char declarations_path[MAXLEN];
+int evt_fd;
+sigset_t blocked_signals;
 
 monitor_t *mon;
 monitor_t *mon_head;
@@ -49,14 +54,42 @@ monitor_t *pri_mon;
 history_t *history_head;
 history_t *history_tail;
 history_t *history_needle;
+unsigned int history_count;
+unsigned int history_limit;
+unsigned long history_stamp;
 rule_t *rule_head;
 rule_t *rule_tail;
-stacking_list_t *stack_head;
-stacking_list_t *stack_tail;
+unsigned long rule_order;
+rule_cause_t **rule_table;
+unsigned int rule_table_size;
+unsigned int rule_table_count;
+stacking_list_t *stack_head[LAYER_LENGTH];
+stacking_list_t *stack_tail[LAYER_LENGTH];
+stacking_list_t **dirty_stack;
+unsigned int dirty_stack_len;
+unsigned int dirty_stack_cap;
+xcb_window_t *dirty_borders;
+unsigned int dirty_borders_len;
+unsigned int dirty_borders_cap;
 subscriber_list_t *subscribe_head;
 subscriber_list_t *subscribe_tail;
+unsigned long subscribe_overflows;
+bool report_dirty;
+batch_t *batch_head;
+batch_t *batch_tail;
 pending_rule_t *pending_rule_head;
 pending_rule_t *pending_rule_tail;
+pending_rule_t *queued_rule_head;
+pending_rule_t *queued_rule_tail;
+unsigned int running_rules;
+rule_coprocess_t rule_coprocess;
+prefetch_t *prefetch_head;
+prefetch_t *prefetch_tail;
+color_t *color_head;
+gc_cache_t *gc_head;
+window_entry_t **wintable;
+unsigned int wintable_size;
+unsigned int wintable_count;
 
 pointer_state_t *frozen_pointer;
 xcb_window_t meta_window;
@@ -77,7 +110,12 @@ void init(void);
 void setup(void);
 void register_events(void);
 void cleanup(void);
+void commit_changes(void);
 bool check_connection (xcb_connection_t *dpy);
+bool watch_fd(int fd, uint32_t events, watch_t *w);
+bool rewatch_fd(int fd, uint32_t events, watch_t *w);
+void unwatch_fd(int fd);
+void restore_signals(void);
 void sig_handler(int sig);
 
 #endif
@@ -28,6 +28,14 @@
 #define SOCKET_PATH_TPL  "/tmp/bspwm%s_%i_%i-socket"
 #define SOCKET_ENV_VAR   "BSPWM_SOCKET"
 
+/* A batch connection starts with this argument and then carries any number of
+ * frames: a 32 bits big endian length followed by a regular message. Each
+ * frame is answered, in order, by a status byte, a 32 bits big endian length
+ * and the output of the command. */
+#define BATCH_MSG        "--batch"
+#define BATCH_HEAD_LEN   4
+#define BATCH_MAX_LEN    (1 << 16)
+
 enum {
 	MSG_SUCCESS,
 	MSG_FAILURE,
@@ -30,6 +30,7 @@
 #include "query.h"
 #include "tree.h"
 #include "window.h"
+#include "lookup.h"
 #include "desktop.h"
 #include "subscribe.h"
 #include "settings.h"
@@ -101,6 +102,7 @@ void transfer_desktop(monitor_t *ms, monitor_t *md, desktop_t *d)
 	for (node_t *n = first_extrema(d->root); n != NULL; n = next_leaf(n, d->root))
 		translate_client(ms, md, n->client);
 
+	invalidate_tree(d->root);
 	arrange(md, d);
 
 	if (d != dd && md->desk == d)
@@ -123,7 +125,11 @@ desktop_t *make_desktop(const char *name)
 		snprintf(d->name, sizeof(d->name), "%s", name);
 	d->prev = d->next = NULL;
 	d->root = d->focus = NULL;
+	d->client_count = d->urgent_count = 0;
+	d->monitor = NULL;
 	initialize_desktop(d);
+	d->arranged_layout = d->layout;
+	d->history = NULL;
 	return d;
 }
 
@@ -134,10 +140,12 @@ void initialize_desktop(desktop_t *d)
 	d->window_gap = window_gap;
 	d->border_width = border_width;
 	d->floating = false;
+	d->dirty = d->laid_out = false;
 }
 
 void insert_desktop(monitor_t *m, desktop_t *d)
 {
+	d->monitor = m;
 	if (m->desk == NULL) {
 		m->desk = d;
 		m->desk_head = d;
@@ -147,6 +155,7 @@ void insert_desktop(monitor_t *m, desktop_t *d)
 		d->prev = m->desk_tail;
 		m->desk_tail = d;
 	}
+	invalidate_lookup();
 }
 
 void add_desktop(monitor_t *m, desktop_t *d)
@@ -161,10 +170,21 @@ void add_desktop(monitor_t *m, desktop_t *d)
 	put_status(SBSC_MASK_REPORT);
 }
 
+void rename_desktop(monitor_t *m, desktop_t *d, const char *name)
+{
+	put_status(SBSC_MASK_DESKTOP_RENAME, "desktop_rename %s %s %s\n", m->name, d->name, name);
+	snprintf(d->name, sizeof(d->name), "%s", name);
+	invalidate_lookup();
+	ewmh_update_desktop_names();
+}
+
 void empty_desktop(desktop_t *d)
 {
+	/* the entries would otherwise point to the freed nodes */
+	history_remove(d, NULL);
 	destroy_tree(d->root);
 	d->root = d->focus = NULL;
+	d->client_count = d->urgent_count = 0;
 }
 
 void unlink_desktop(monitor_t *m, desktop_t *d)
@@ -183,6 +203,7 @@ void unlink_desktop(monitor_t *m, desktop_t *d)
 	if (m->desk == d)
 		m->desk = (last_desk == NULL ? (prev == NULL ? next : prev) : last_desk);
 	d->prev = d->next = NULL;
+	invalidate_lookup();
 }
 
 void remove_desktop(monitor_t *m, desktop_t *d)
@@ -191,7 +212,6 @@ void remove_desktop(monitor_t *m, desktop_t *d)
 	put_status(SBSC_MASK_DESKTOP_REMOVE, "desktop_remove %s\n", d->name);
 
 	unlink_desktop(m, d);
-	history_remove(d, NULL);
 	empty_desktop(d);
 	free(d);
 
@@ -270,12 +290,18 @@ void swap_desktops(monitor_t *m1, desktop_t *d1, monitor_t *m2, desktop_t *d2)
 	d2->prev = p1 == d2 ? d1 : p1;
 	d2->next = n1 == d2 ? d1 : n1;
 
+	invalidate_lookup();
+
 	if (m1 != m2) {
 		for (node_t *n = first_extrema(d1->root); n != NULL; n = next_leaf(n, d1->root))
 			translate_client(m1, m2, n->client);
 		for (node_t *n = first_extrema(d2->root); n != NULL; n = next_leaf(n, d2->root))
 			translate_client(m2, m1, n->client);
+		d1->monitor = m2;
+		d2->monitor = m1;
 		history_swap_desktops(m1, d1, m2, d2);
+		invalidate_tree(d1->root);
+		invalidate_tree(d2->root);
 		arrange(m1, d2);
 		arrange(m2, d1);
 		if (d1_focused && !d2_focused) {
@@ -312,8 +338,5 @@ void hide_desktop(desktop_t *d)
 
 bool is_urgent(desktop_t *d)
 {
-	for (node_t *n = first_extrema(d->root); n != NULL; n = next_leaf(n, d->root))
-		if (n->client->urgent)
-			return true;
-	return false;
+	return (d->urgent_count > 0);
 }
@@ -35,6 +35,7 @@ desktop_t *make_desktop(const char *name);
 void initialize_desktop(desktop_t *d);
 void insert_desktop(monitor_t *m, desktop_t *d);
 void add_desktop(monitor_t *m, desktop_t *d);
+void rename_desktop(monitor_t *m, desktop_t *d, const char *name);
 void empty_desktop(desktop_t *d);
 void unlink_desktop(monitor_t *m, desktop_t *d);
 void remove_desktop(monitor_t *m, desktop_t *d);
@@ -24,17 +24,48 @@
 
 #include <stdlib.h>
 #include "bspwm.h"
+#include "backend.h"
 #include "ewmh.h"
 #include "monitor.h"
 #include "query.h"
 #include "settings.h"
+#include "stats.h"
 #include "tree.h"
 #include "window.h"
+#include "wintable.h"
 #include "events.h"
 
+/* Handles the queued events by chunks: the properties of the windows of
+ * every map request of a chunk are requested before any of them is
+ * scheduled, so that managing a burst of windows costs one round trip.
+ * Waiting for a reply makes xcb read the events that follow it off the
+ * socket, which epoll won't report again: loop until none is left. */
+void handle_events(void)
+{
+	xcb_generic_event_t *queue[EVENT_CHUNK_LEN];
+	unsigned int len;
+
+	do {
+		len = 0;
+		while (len < LENGTH(queue) && (queue[len] = xcb_poll_for_event(dpy)) != NULL)
+			len++;
+		for (unsigned int i = 0; i < len; i++)
+			if (XCB_EVENT_RESPONSE_TYPE(queue[i]) == XCB_MAP_REQUEST)
+				prefetch_window(((xcb_map_request_event_t *) queue[i])->window);
+		for (unsigned int i = 0; i < len; i++) {
+			handle_event(queue[i]);
+			free(queue[i]);
+		}
+		while (prefetch_head != NULL)
+			remove_prefetch(prefetch_head);
+	} while (len > 0);
+}
+
 void handle_event(xcb_generic_event_t *evt)
 {
 	uint8_t resp_type = XCB_EVENT_RESPONSE_TYPE(evt);
+	struct timespec start;
+	stats_clock(&start);
 	switch (resp_type) {
 		case XCB_MAP_REQUEST:
 			map_request(evt);
@@ -71,6 +102,7 @@ void handle_event(xcb_generic_event_t *evt)
 				update_monitors();
 			break;
 	}
+	record_event(resp_type, &start);
 }
 
 void map_request(xcb_generic_event_t *evt)
@@ -118,6 +150,7 @@ void configure_request(xcb_generic_event_t *evt)
 		xcb_window_t win = c->window;
 		unsigned int bw = c->border_width;
 
+		update_layout(loc.monitor, loc.desktop);
 		if (c->fullscreen)
 			rect = loc.monitor->rectangle;
 		else
@@ -134,10 +167,12 @@ void configure_request(xcb_generic_event_t *evt)
 		evt.border_width = bw;
 		evt.override_redirect = false;
 
-		xcb_send_event(dpy, false, win, XCB_EVENT_MASK_STRUCTURE_NOTIFY, (const char *) &evt);
+		backend->send_event(win, XCB_EVENT_MASK_STRUCTURE_NOTIFY, (const char *) &evt);
 
-		if (c->pseudo_tiled)
+		if (c->pseudo_tiled) {
+			invalidate_layout(loc.node);
 			arrange(loc.monitor, loc.desktop);
+		}
 	} else {
 		uint16_t mask = 0;
 		uint32_t values[7];
@@ -192,7 +227,36 @@ void configure_request(xcb_generic_event_t *evt)
 			values[i++] = e->stack_mode;
 		}
 
-		xcb_configure_window(dpy, e->window, mask, values);
+		backend->configure_window(e->window, mask, values);
+
+		/* keep track of what the server now holds: a partial update is
+		 * only meaningful on top of a fully known geometry */
+		uint16_t geometry = XCB_CONFIG_WINDOW_X_Y_WIDTH_HEIGHT;
+		if (is_managed && (c->sent_rectangle.width != 0 || (mask & geometry) == geometry)) {
+			xcb_rectangle_t *s = &c->sent_rectangle;
+			if (mask & XCB_CONFIG_WINDOW_X)
+				s->x = e->x;
+			if (mask & XCB_CONFIG_WINDOW_Y)
+				s->y = e->y;
+			if (mask & XCB_CONFIG_WINDOW_WIDTH)
+				s->width = w;
+			if (mask & XCB_CONFIG_WINDOW_HEIGHT)
+				s->height = h;
+		}
+
+		/* the geometry of a window waiting for its rules was fetched when it was scheduled */
+		window_entry_t *we = (is_managed ? NULL : wintable_find(e->window));
+		if (we != NULL && we->rule != NULL) {
+			xcb_rectangle_t *r = &we->rule->csq->rectangle;
+			if (e->value_mask & XCB_CONFIG_WINDOW_X)
+				r->x = e->x;
+			if (e->value_mask & XCB_CONFIG_WINDOW_Y)
+				r->y = e->y;
+			if (e->value_mask & XCB_CONFIG_WINDOW_WIDTH)
+				r->width = e->width;
+			if (e->value_mask & XCB_CONFIG_WINDOW_HEIGHT)
+				r->height = e->height;
+		}
 	}
 
 	if (is_managed)
@@ -234,7 +298,7 @@ void property_notify(xcb_generic_event_t *evt)
 		xcb_icccm_wm_hints_t hints;
 		if (xcb_icccm_get_wm_hints_reply(dpy, xcb_icccm_get_wm_hints(dpy, e->window), &hints, NULL) == 1 &&
 		    (hints.flags & XCB_ICCCM_WM_HINT_X_URGENCY))
-			set_urgency(loc.monitor, loc.desktop, loc.node, xcb_icccm_wm_hints_get_urgency(&hints));
+			set_urgency(loc.desktop, loc.node, xcb_icccm_wm_hints_get_urgency(&hints));
 	} else if (e->atom == XCB_ATOM_WM_NORMAL_HINTS) {
 		client_t *c = loc.node->client;
 		xcb_size_hints_t size_hints;
@@ -249,6 +313,7 @@ void property_notify(xcb_generic_event_t *evt)
 			restrain_floating_size(c, &w, &h);
 			c->floating_rectangle.width = w;
 			c->floating_rectangle.height = h;
+			invalidate_layout(loc.node);
 			arrange(loc.monitor, loc.desktop);
 		}
 	}
@@ -402,11 +467,11 @@ void handle_state(monitor_t *m, desktop_t *d, node_t *n, xcb_atom_t state, unsig
 			set_sticky(m, d, n, !n->client->sticky);
 	} else if (state == ewmh->_NET_WM_STATE_DEMANDS_ATTENTION) {
 		if (action == XCB_EWMH_WM_STATE_ADD)
-			set_urgency(m, d, n, true);
+			set_urgency(d, n, true);
 		else if (action == XCB_EWMH_WM_STATE_REMOVE)
-			set_urgency(m, d, n, false);
+			set_urgency(d, n, false);
 		else if (action == XCB_EWMH_WM_STATE_TOGGLE)
-			set_urgency(m, d, n, !n->client->urgent);
+			set_urgency(d, n, !n->client->urgent);
 	}
 }
 
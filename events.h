@@ -32,6 +32,9 @@ uint8_t randr_base;
 uint16_t last_motion_x, last_motion_y;
 xcb_timestamp_t last_motion_time;
 
+#define EVENT_CHUNK_LEN  64
+
+void handle_events(void);
 void handle_event(xcb_generic_event_t *evt);
 void map_request(xcb_generic_event_t *evt);
 void configure_request(xcb_generic_event_t *evt);
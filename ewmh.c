@@ -25,8 +25,10 @@
 #include <string.h>
 #include <unistd.h>
 #include "bspwm.h"
+#include "backend.h"
 #include "settings.h"
 #include "tree.h"
+#include "lookup.h"
 #include "ewmh.h"
 
 void ewmh_init(void)
@@ -34,65 +36,102 @@ void ewmh_init(void)
 	ewmh = malloc(sizeof(xcb_ewmh_connection_t));
 	if (xcb_ewmh_init_atoms_replies(ewmh, xcb_ewmh_init_atoms(dpy, ewmh), NULL) == 0)
 		err("Can't initialize EWMH atoms.\n");
+	ewmh_dirty = 0;
 }
 
 void ewmh_update_active_window(void)
 {
-	xcb_window_t win = (mon->desk->focus == NULL ? XCB_NONE : mon->desk->focus->client->window);
-	xcb_ewmh_set_active_window(ewmh, default_screen, win);
+	ewmh_dirty |= EWMH_ACTIVE_WINDOW;
 }
 
 void ewmh_update_number_of_desktops(void)
 {
-	xcb_ewmh_set_number_of_desktops(ewmh, default_screen, num_desktops);
+	ewmh_dirty |= EWMH_NUMBER_OF_DESKTOPS;
 }
 
 uint32_t ewmh_get_desktop_index(desktop_t *d)
 {
-	uint32_t i = 0;
-	for (monitor_t *m = mon_head; m != NULL; m = m->next)
-		for (desktop_t *cd = m->desk_head; cd != NULL; cd = cd->next, i++)
-			if (d == cd)
-				return i;
-	return 0;
+	return desktop_ordinal(d);
 }
 
 bool ewmh_locate_desktop(uint32_t i, coordinates_t *loc)
 {
-	for (monitor_t *m = mon_head; m != NULL; m = m->next)
-		for (desktop_t *d = m->desk_head; d != NULL; d = d->next, i--)
-			if (i == 0) {
-				loc->monitor = m;
-				loc->desktop = d;
-				loc->node = NULL;
-				return true;
-			}
-	return false;
+	desktop_t *d = desktop_at(i);
+	if (d == NULL)
+		return false;
+	loc->monitor = d->monitor;
+	loc->desktop = d;
+	loc->node = NULL;
+	return true;
 }
 
 void ewmh_update_current_desktop(void)
 {
-	uint32_t i = ewmh_get_desktop_index(mon->desk);
-	xcb_ewmh_set_current_desktop(ewmh, default_screen, i);
+	ewmh_dirty |= EWMH_CURRENT_DESKTOP;
 }
 
 void ewmh_set_wm_desktop(node_t *n, desktop_t *d)
 {
 	uint32_t i = ewmh_get_desktop_index(d);
-	xcb_ewmh_set_wm_desktop(ewmh, n->client->window, i);
+	backend->change_property(n->client->window, ewmh->_NET_WM_DESKTOP, XCB_ATOM_CARDINAL, 32, 1, &i);
 }
 
 void ewmh_update_wm_desktops(void)
 {
+	ewmh_dirty |= EWMH_WM_DESKTOPS;
+}
+
+void ewmh_update_desktop_names(void)
+{
+	ewmh_dirty |= EWMH_DESKTOP_NAMES;
+}
+
+void ewmh_update_client_list(void)
+{
+	ewmh_dirty |= EWMH_CLIENT_LIST;
+}
+
+/* Writes the root window properties invalidated since the last commit */
+void ewmh_commit(void)
+{
+	if (ewmh_dirty == 0 || mon == NULL)
+		return;
+
+	if (ewmh_dirty & EWMH_ACTIVE_WINDOW) {
+		xcb_window_t win = (mon->desk->focus == NULL ? XCB_NONE : mon->desk->focus->client->window);
+		backend->change_property(root, ewmh->_NET_ACTIVE_WINDOW, XCB_ATOM_WINDOW, 32, 1, &win);
+	}
+
+	if (ewmh_dirty & EWMH_NUMBER_OF_DESKTOPS)
+		backend->change_property(root, ewmh->_NET_NUMBER_OF_DESKTOPS, XCB_ATOM_CARDINAL, 32, 1, &num_desktops);
+
+	if (ewmh_dirty & EWMH_CURRENT_DESKTOP) {
+		uint32_t i = ewmh_get_desktop_index(mon->desk);
+		backend->change_property(root, ewmh->_NET_CURRENT_DESKTOP, XCB_ATOM_CARDINAL, 32, 1, &i);
+	}
+
+	if (ewmh_dirty & EWMH_WM_DESKTOPS)
+		commit_wm_desktops();
+
+	if (ewmh_dirty & EWMH_DESKTOP_NAMES)
+		commit_desktop_names();
+
+	if (ewmh_dirty & EWMH_CLIENT_LIST)
+		commit_client_list();
+
+	ewmh_dirty = 0;
+}
+
+void commit_wm_desktops(void)
+{
+	uint32_t i = 0;
 	for (monitor_t *m = mon_head; m != NULL; m = m->next)
-		for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
-			uint32_t i = ewmh_get_desktop_index(d);
+		for (desktop_t *d = m->desk_head; d != NULL; d = d->next, i++)
 			for (node_t *n = first_extrema(d->root); n != NULL; n = next_leaf(n, d->root))
-				xcb_ewmh_set_wm_desktop(ewmh, n->client->window, i);
-		}
+				backend->change_property(n->client->window, ewmh->_NET_WM_DESKTOP, XCB_ATOM_CARDINAL, 32, 1, &i);
 }
 
-void ewmh_update_desktop_names(void)
+void commit_desktop_names(void)
 {
 	char names[MAXLEN];
 	unsigned int i, j;
@@ -112,14 +151,14 @@ void ewmh_update_desktop_names(void)
 		return;
 
 	names_len = i - 1;
-	xcb_ewmh_set_desktop_names(ewmh, default_screen, names_len, names);
+	backend->change_property(root, ewmh->_NET_DESKTOP_NAMES, ewmh->UTF8_STRING, 8, names_len, names);
 }
 
-void ewmh_update_client_list(void)
+void commit_client_list(void)
 {
 	if (num_clients == 0) {
-		xcb_ewmh_set_client_list(ewmh, default_screen, 0, NULL);
-		xcb_ewmh_set_client_list_stacking(ewmh, default_screen, 0, NULL);
+		backend->change_property(root, ewmh->_NET_CLIENT_LIST, XCB_ATOM_WINDOW, 32, 0, NULL);
+		backend->change_property(root, ewmh->_NET_CLIENT_LIST_STACKING, XCB_ATOM_WINDOW, 32, 0, NULL);
 		return;
 	}
 
@@ -131,8 +170,8 @@ void ewmh_update_client_list(void)
 			for (node_t *n = first_extrema(d->root); n != NULL; n = next_leaf(n, d->root))
 				wins[i++] = n->client->window;
 
-	xcb_ewmh_set_client_list(ewmh, default_screen, num_clients, wins);
-	xcb_ewmh_set_client_list_stacking(ewmh, default_screen, num_clients, wins);
+	backend->change_property(root, ewmh->_NET_CLIENT_LIST, XCB_ATOM_WINDOW, 32, num_clients, wins);
+	backend->change_property(root, ewmh->_NET_CLIENT_LIST_STACKING, XCB_ATOM_WINDOW, 32, num_clients, wins);
 }
 
 bool ewmh_wm_state_add(client_t *c, xcb_atom_t state)
@@ -144,7 +183,7 @@ bool ewmh_wm_state_add(client_t *c, xcb_atom_t state)
 			return false;
 	c->wm_state[c->num_states] = state;
 	c->num_states++;
-	xcb_ewmh_set_wm_state(ewmh, c->window, c->num_states, c->wm_state);
+	backend->change_property(c->window, ewmh->_NET_WM_STATE, XCB_ATOM_ATOM, 32, c->num_states, c->wm_state);
 	return true;
 }
 
@@ -156,7 +195,7 @@ bool ewmh_wm_state_remove(client_t *c, xcb_atom_t state)
 			for (int j = i; j < (c->num_states - 1); j++)
 				c->wm_state[j] = c->wm_state[j + 1];
 			c->num_states--;
-			xcb_ewmh_set_wm_state(ewmh, c->window, c->num_states, c->wm_state);
+			backend->change_property(c->window, ewmh->_NET_WM_STATE, XCB_ATOM_ATOM, 32, c->num_states, c->wm_state);
 			return true;
 		}
 	return false;
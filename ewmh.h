@@ -27,7 +27,17 @@
 
 #include <xcb/xcb_ewmh.h>
 
+typedef enum {
+	EWMH_ACTIVE_WINDOW = 1 << 0,
+	EWMH_NUMBER_OF_DESKTOPS = 1 << 1,
+	EWMH_CURRENT_DESKTOP = 1 << 2,
+	EWMH_WM_DESKTOPS = 1 << 3,
+	EWMH_DESKTOP_NAMES = 1 << 4,
+	EWMH_CLIENT_LIST = 1 << 5
+} ewmh_property_t;
+
 xcb_ewmh_connection_t *ewmh;
+unsigned int ewmh_dirty;
 
 void ewmh_init(void);
 void ewmh_update_active_window(void);
@@ -39,6 +49,10 @@ void ewmh_set_wm_desktop(node_t *n, desktop_t *d);
 void ewmh_update_wm_desktops(void);
 void ewmh_update_desktop_names(void);
 void ewmh_update_client_list(void);
+void ewmh_commit(void);
+void commit_wm_desktops(void);
+void commit_desktop_names(void);
+void commit_client_list(void);
 bool ewmh_wm_state_add(client_t *c, xcb_atom_t state);
 bool ewmh_wm_state_remove(client_t *c, xcb_atom_t state);
 void ewmh_set_supporting(xcb_window_t win);
@@ -45,41 +45,55 @@ void err(char *fmt, ...)
 	exit(EXIT_FAILURE);
 }
 
-bool get_color(char *col, xcb_window_t win, uint32_t *pxl)
+double distance(xcb_point_t a, xcb_point_t b)
 {
-	xcb_colormap_t map = screen->default_colormap;
-	xcb_get_window_attributes_reply_t *reply = xcb_get_window_attributes_reply(dpy, xcb_get_window_attributes(dpy, win), NULL);
-	if (reply != NULL)
-		map = reply->colormap;
-	free(reply);
+	return hypot(a.x - b.x, a.y - b.y);
+}
 
-	if (col[0] == '#') {
-		unsigned int red, green, blue;
-		if (sscanf(col + 1, "%02x%02x%02x", &red, &green, &blue) == 3) {
-			/* 2**16 - 1 == 0xffff and 0x101 * 0xij == 0xijij */
-			red *= 0x101;
-			green *= 0x101;
-			blue *= 0x101;
-			xcb_alloc_color_reply_t *reply = xcb_alloc_color_reply(dpy, xcb_alloc_color(dpy, map, red, green, blue), NULL);
-			if (reply != NULL) {
-				*pxl = reply->pixel;
-				free(reply);
-				return true;
+int split_words(char *s, char **words, int max)
+{
+	int num = 0;
+	char *dst = s;
+	while (*s != '\0') {
+		while (*s == ' ' || *s == '\t' || *s == '\n')
+			s++;
+		if (*s == '\0' || *s == '#')
+			break;
+		if (num >= max)
+			return -1;
+		words[num++] = dst;
+		char quote = '\0';
+		while (*s != '\0' && (quote != '\0' || (*s != ' ' && *s != '\t' && *s != '\n'))) {
+			if (quote == '\0' && (*s == '\'' || *s == '"')) {
+				quote = *s++;
+			} else if (quote != '\0' && *s == quote) {
+				quote = '\0';
+				s++;
+			} else if (*s == '\\' && quote != '\'' && s[1] == '\n') {
+				s += 2;
+			} else if (*s == '\\' && quote != '\'' && s[1] != '\0') {
+				s++;
+				*dst++ = *s++;
+			} else {
+				*dst++ = *s++;
 			}
 		}
-	} else {
-		xcb_alloc_named_color_reply_t *reply = xcb_alloc_named_color_reply(dpy, xcb_alloc_named_color(dpy, map, strlen(col), col), NULL);
-		if (reply != NULL) {
-			*pxl = reply->pixel;
-			free(reply);
-			return true;
-		}
+		if (quote != '\0')
+			return -1;
+		if (*s != '\0')
+			s++;
+		*dst++ = '\0';
 	}
-	*pxl = 0;
-	return false;
+	return num;
 }
 
-double distance(xcb_point_t a, xcb_point_t b)
+/* FNV-1a */
+uint32_t hash_string(const char *s)
 {
-	return hypot(a.x - b.x, a.y - b.y);
+	uint32_t h = 2166136261u;
+	for (; *s != '\0'; s++) {
+		h ^= (unsigned char) *s;
+		h *= 16777619u;
+	}
+	return h;
 }
@@ -57,7 +57,8 @@
 
 void warn(char *fmt, ...);
 void err(char *fmt, ...);
-bool get_color(char *col, xcb_window_t win, uint32_t *pxl);
 double distance(xcb_point_t a, xcb_point_t b);
+int split_words(char *s, char **words, int max);
+uint32_t hash_string(const char *s);
 
 #endif
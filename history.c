@@ -25,6 +25,7 @@
 #include <stdlib.h>
 #include "bspwm.h"
 #include "query.h"
+#include "history.h"
 
 history_t *make_history(monitor_t *m, desktop_t *d, node_t *n)
 {
@@ -32,6 +33,7 @@ history_t *make_history(monitor_t *m, desktop_t *d, node_t *n)
 	h->loc = (coordinates_t) {m, d, n};
 	h->prev = h->next = NULL;
 	h->latest = true;
+	h->stamp = ++history_stamp;
 	return h;
 }
 
@@ -40,19 +42,62 @@ void history_add(monitor_t *m, desktop_t *d, node_t *n)
 	if (!record_history)
 		return;
 	history_needle = NULL;
+	if (history_tail != NULL &&
+	    ((n != NULL && history_tail->loc.node == n) || (n == NULL && d == history_tail->loc.desktop)))
+		return;
 	history_t *h = make_history(m, d, n);
+	/* the entries of a node, or of an empty desktop, are superseded by the new one */
+	history_t **latest = (n != NULL ? &n->history : &d->history);
+	if (*latest != NULL)
+		(*latest)->latest = false;
+	*latest = h;
 	if (history_head == NULL) {
 		history_head = history_tail = h;
-	} else if ((n != NULL && history_tail->loc.node != n) || (n == NULL && d != history_tail->loc.desktop)) {
-		for (history_t *hh = history_tail; hh != NULL; hh = hh->prev)
-			if ((n != NULL && hh->loc.node == n) || (n == NULL && d == hh->loc.desktop))
-				hh->latest = false;
+	} else {
 		history_tail->next = h;
 		h->prev = history_tail;
 		history_tail = h;
-	} else {
-		free(h);
 	}
+	history_count++;
+	if (history_count > history_limit)
+		compact_history();
+}
+
+/* Drops the oldest superseded entries: they are skipped by every lookup, so
+ * only the latest entries of each node and desktop need to be kept */
+void compact_history(void)
+{
+	history_t *h = history_head;
+	while (h != NULL && history_count > HISTORY_MAX / 2) {
+		history_t *next = h->next;
+		if (!h->latest) {
+			if (h->prev != NULL)
+				h->prev->next = next;
+			if (next != NULL)
+				next->prev = h->prev;
+			if (history_head == h)
+				history_head = next;
+			if (history_tail == h)
+				history_tail = h->prev;
+			if (history_needle == h)
+				history_needle = NULL;
+			free_history(h);
+		}
+		h = next;
+	}
+	history_limit = MAX(HISTORY_MAX, 2 * history_count);
+}
+
+/* Frees the given unlinked entry */
+void free_history(history_t *h)
+{
+	if (h->latest) {
+		history_t **latest = (h->loc.node != NULL ? &h->loc.node->history : &h->loc.desktop->history);
+		if (*latest == h)
+			*latest = NULL;
+	}
+	history_count--;
+	free(h);
 }
 
 void history_transfer_node(monitor_t *m, desktop_t *d, node_t *n)
@@ -107,10 +152,10 @@ void history_remove(desktop_t *d, node_t *n)
 				       (a->loc.node == NULL && a->loc.desktop == c->loc.desktop))) {
 					history_t *d = c->prev;
 					if (history_head == c)
-						history_head = history_tail;
+						history_head = a;
 					if (history_needle == c)
 						history_needle = history_tail;
-					free(c);
+					free_history(c);
 					c = d;
 				}
 				a->prev = c;
@@ -123,7 +168,7 @@ void history_remove(desktop_t *d, node_t *n)
 				history_head = a;
 			if (history_needle == b)
 				history_needle = c;
-			free(b);
+			free_history(b);
 			b = c;
 		} else {
 			b = b->prev;
@@ -136,10 +181,11 @@ void empty_history(void)
 	history_t *h = history_head;
 	while (h != NULL) {
 		history_t *next = h->next;
-		free(h);
+		free_history(h);
 		h = next;
 	}
-	history_head = history_tail = NULL;
+	history_head = history_tail = history_needle = NULL;
+	history_count = 0;
 }
 
 node_t *history_get_node(desktop_t *d, node_t *n)
@@ -224,16 +270,12 @@ bool history_find_monitor(history_dir_t hdi, coordinates_t *ref, coordinates_t *
 	return false;
 }
 
+/* Returns how long ago the given node was last focused on the given desktop,
+ * in focus changes, or -1 if it never was */
 int history_rank(desktop_t *d, node_t *n)
 {
-	int i = 0;
-	history_t *h = history_tail;
-	while (h != NULL && (!h->latest || h->loc.node != n || h->loc.desktop != d)) {
-		h = h->prev;
-		i++;
-	}
-	if (h == NULL)
+	history_t *h = n->history;
+	if (h == NULL || h->loc.desktop != d)
 		return -1;
-	else
-		return i;
+	return history_tail->stamp - h->stamp;
 }
@@ -27,8 +27,12 @@
 
 #include "types.h"
 
+#define HISTORY_MAX  1024
+
 history_t *make_history(monitor_t *m, desktop_t *d, node_t *n);
 void history_add(monitor_t *m, desktop_t *d, node_t *n);
+void compact_history(void);
+void free_history(history_t *h);
 void history_transfer_node(monitor_t *m, desktop_t *d, node_t *n);
 void history_transfer_desktop(monitor_t *m, desktop_t *d);
 void history_swap_nodes(monitor_t *m1, desktop_t *d1, node_t *n1, monitor_t *m2, desktop_t *d2, node_t *n2);
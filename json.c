@@ -0,0 +1,146 @@
+/* Copyright (c) 2012, Bastien Dejean
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <xcb/xcb.h>
+#include "json.h"
+
+void json_init(json_writer_t *w, FILE *out)
+{
+	w->out = out;
+	w->sep = w->key = false;
+}
+
+void json_begin_object(json_writer_t *w)
+{
+	json_separate(w);
+	fputc('{', w->out);
+	w->sep = false;
+}
+
+void json_end_object(json_writer_t *w)
+{
+	fputc('}', w->out);
+	w->sep = true;
+}
+
+void json_begin_array(json_writer_t *w)
+{
+	json_separate(w);
+	fputc('[', w->out);
+	w->sep = false;
+}
+
+void json_end_array(json_writer_t *w)
+{
+	fputc(']', w->out);
+	w->sep = true;
+}
+
+void json_key(json_writer_t *w, const char *key)
+{
+	json_string(w, key);
+	fputc(':', w->out);
+	w->key = true;
+}
+
+void json_string(json_writer_t *w, const char *s)
+{
+	json_separate(w);
+	fputc('"', w->out);
+	for (; *s != '\0'; s++) {
+		unsigned char c = *s;
+		if (c == '"' || c == '\\')
+			fprintf(w->out, "\\%c", c);
+		else if (c == '\n')
+			fputs("\\n", w->out);
+		else if (c == '\t')
+			fputs("\\t", w->out);
+		else if (c < 0x20)
+			fprintf(w->out, "\\u%04x", c);
+		else
+			fputc(c, w->out);
+	}
+	fputc('"', w->out);
+	w->sep = true;
+}
+
+void json_int(json_writer_t *w, long i)
+{
+	json_separate(w);
+	fprintf(w->out, "%li", i);
+	w->sep = true;
+}
+
+void json_uint(json_writer_t *w, unsigned long u)
+{
+	json_separate(w);
+	fprintf(w->out, "%lu", u);
+	w->sep = true;
+}
+
+void json_double(json_writer_t *w, double d)
+{
+	json_separate(w);
+	fprintf(w->out, "%lf", d);
+	w->sep = true;
+}
+
+void json_bool(json_writer_t *w, bool b)
+{
+	json_separate(w);
+	fputs(b ? "true" : "false", w->out);
+	w->sep = true;
+}
+
+void json_null(json_writer_t *w)
+{
+	json_separate(w);
+	fputs("null", w->out);
+	w->sep = true;
+}
+
+void json_rectangle(json_writer_t *w, xcb_rectangle_t r)
+{
+	json_begin_object(w);
+	json_key(w, "x");
+	json_int(w, r.x);
+	json_key(w, "y");
+	json_int(w, r.y);
+	json_key(w, "width");
+	json_uint(w, r.width);
+	json_key(w, "height");
+	json_uint(w, r.height);
+	json_end_object(w);
+}
+
+/* Writes the comma due before a value, unless it follows its key */
+void json_separate(json_writer_t *w)
+{
+	if (w->key)
+		w->key = false;
+	else if (w->sep)
+		fputc(',', w->out);
+}
@@ -0,0 +1,170 @@
+/* Copyright (c) 2012, Bastien Dejean
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "bspwm.h"
+#include "helpers.h"
+#include "lookup.h"
+
+void invalidate_lookup(void)
+{
+	lookup_stale = true;
+}
+
+/* Returns the smallest power of two greater than twice n */
+unsigned int lookup_table_size(unsigned int n)
+{
+	unsigned int size = LOOKUP_MIN_SIZE;
+	while (size <= 2 * n)
+		size *= 2;
+	return size;
+}
+
+/* Rebuilds the ordinal arrays and the name tables from the monitor and
+ * desktop lists, if the latter changed since the last rebuild */
+void update_lookup(void)
+{
+	if (!lookup_stale)
+		return;
+
+	unsigned int nm = 0, nd = 0;
+	for (monitor_t *m = mon_head; m != NULL; m = m->next, nm++)
+		for (desktop_t *d = m->desk_head; d != NULL; d = d->next)
+			nd++;
+
+	unsigned int msize = lookup_table_size(nm);
+	unsigned int dsize = lookup_table_size(nd);
+	monitor_t **mlist = realloc(monitor_list, (nm + 1) * sizeof(monitor_t *));
+	if (mlist != NULL)
+		monitor_list = mlist;
+	desktop_t **dlist = realloc(desktop_list, (nd + 1) * sizeof(desktop_t *));
+	if (dlist != NULL)
+		desktop_list = dlist;
+	monitor_t **mtable = calloc(msize, sizeof(monitor_t *));
+	desktop_t **dtable = calloc(dsize, sizeof(desktop_t *));
+	if (mlist == NULL || dlist == NULL || mtable == NULL || dtable == NULL) {
+		warn("Couldn't rebuild the lookup tables.\n");
+		free(mtable);
+		free(dtable);
+		return;
+	}
+
+	free(monitor_table);
+	free(desktop_table);
+	monitor_table = mtable;
+	desktop_table = dtable;
+	monitor_table_size = msize;
+	desktop_table_size = dsize;
+	monitor_count = desktop_count = 0;
+
+	for (monitor_t *m = mon_head; m != NULL; m = m->next) {
+		monitor_list[monitor_count++] = m;
+		m->desk_index = desktop_count;
+		/* the first of several homonyms wins, as with the former list walks */
+		unsigned int h = hash_string(m->name) & (msize - 1);
+		while (monitor_table[h] != NULL && !streq(monitor_table[h]->name, m->name))
+			h = (h + 1) & (msize - 1);
+		if (monitor_table[h] == NULL)
+			monitor_table[h] = m;
+		for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
+			d->index = desktop_count;
+			desktop_list[desktop_count++] = d;
+			h = hash_string(d->name) & (dsize - 1);
+			while (desktop_table[h] != NULL && !streq(desktop_table[h]->name, d->name))
+				h = (h + 1) & (dsize - 1);
+			if (desktop_table[h] == NULL)
+				desktop_table[h] = d;
+		}
+		m->desk_count = desktop_count - m->desk_index;
+	}
+
+	lookup_stale = false;
+}
+
+desktop_t *lookup_desktop(const char *name)
+{
+	update_lookup();
+	if (desktop_table_size == 0)
+		return NULL;
+	unsigned int h = hash_string(name) & (desktop_table_size - 1);
+	while (desktop_table[h] != NULL) {
+		if (streq(desktop_table[h]->name, name))
+			return desktop_table[h];
+		h = (h + 1) & (desktop_table_size - 1);
+	}
+	return NULL;
+}
+
+monitor_t *lookup_monitor(const char *name)
+{
+	update_lookup();
+	if (monitor_table_size == 0)
+		return NULL;
+	unsigned int h = hash_string(name) & (monitor_table_size - 1);
+	while (monitor_table[h] != NULL) {
+		if (streq(monitor_table[h]->name, name))
+			return monitor_table[h];
+		h = (h + 1) & (monitor_table_size - 1);
+	}
+	return NULL;
+}
+
+/* The ordinal accessors are zero-based */
+desktop_t *desktop_at(unsigned int i)
+{
+	update_lookup();
+	if (i >= desktop_count)
+		return NULL;
+	return desktop_list[i];
+}
+
+monitor_t *monitor_at(unsigned int i)
+{
+	update_lookup();
+	if (i >= monitor_count)
+		return NULL;
+	return monitor_list[i];
+}
+
+unsigned int desktop_ordinal(desktop_t *d)
+{
+	update_lookup();
+	return d->index;
+}
+
+void empty_lookup(void)
+{
+	free(monitor_list);
+	free(desktop_list);
+	free(monitor_table);
+	free(desktop_table);
+	monitor_list = NULL;
+	desktop_list = NULL;
+	monitor_table = NULL;
+	desktop_table = NULL;
+	monitor_table_size = desktop_table_size = 0;
+	monitor_count = desktop_count = 0;
+	lookup_stale = true;
+}
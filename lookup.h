@@ -0,0 +1,52 @@
+/* Copyright (c) 2012, Bastien Dejean
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BSPWM_LOOKUP_H
+#define BSPWM_LOOKUP_H
+
+#include "types.h"
+
+#define LOOKUP_MIN_SIZE  16
+
+monitor_t **monitor_list;
+desktop_t **desktop_list;
+unsigned int monitor_count;
+unsigned int desktop_count;
+monitor_t **monitor_table;
+desktop_t **desktop_table;
+unsigned int monitor_table_size;
+unsigned int desktop_table_size;
+bool lookup_stale;
+
+void invalidate_lookup(void);
+unsigned int lookup_table_size(unsigned int n);
+void update_lookup(void);
+desktop_t *lookup_desktop(const char *name);
+monitor_t *lookup_monitor(const char *name);
+desktop_t *desktop_at(unsigned int i);
+monitor_t *monitor_at(unsigned int i);
+unsigned int desktop_ordinal(desktop_t *d);
+void empty_lookup(void);
+
+#endif
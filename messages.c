@@ -27,6 +27,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "bspwm.h"
+#include "backend.h"
 #include "desktop.h"
 #include "ewmh.h"
 #include "history.h"
@@ -36,6 +37,7 @@
 #include "rule.h"
 #include "restore.h"
 #include "settings.h"
+#include "stats.h"
 #include "tree.h"
 #include "window.h"
 #include "common.h"
@@ -73,7 +75,10 @@ int handle_message(char *msg, int msg_len, FILE *rsp)
 	}
 
 	char **args_orig = args;
+	struct timespec start;
+	stats_clock(&start);
 	int ret = process_message(args, num, rsp);
+	record_command(args[0], &start);
 	free(args_orig);
 	return ret;
 }
@@ -213,11 +218,11 @@ int cmd_window(char **args, int num)
 				set_floating(trg.node, (a == ALTER_SET ? b : !trg.node->client->floating));
 				dirty = true;
 			} else if (streq("locked", key)) {
-				set_locked(trg.monitor, trg.desktop, trg.node, (a == ALTER_SET ? b : !trg.node->client->locked));
+				set_locked(trg.node, (a == ALTER_SET ? b : !trg.node->client->locked));
 			} else if (streq("sticky", key)) {
 				set_sticky(trg.monitor, trg.desktop, trg.node, (a == ALTER_SET ? b : !trg.node->client->sticky));
 			} else if (streq("private", key)) {
-				set_private(trg.monitor, trg.desktop, trg.node, (a == ALTER_SET ? b : !trg.node->client->private));
+				set_private(trg.node, (a == ALTER_SET ? b : !trg.node->client->private));
 			} else {
 				return MSG_FAILURE;
 			}
@@ -248,7 +253,7 @@ int cmd_window(char **args, int num)
 						trg.node->split_dir = dir;
 						trg.node->split_ratio = rat;
 					}
-					window_draw_border(trg.node, trg.desktop->focus == trg.node, mon == trg.monitor);
+					invalidate_border(trg.node);
 				} else {
 					return MSG_FAILURE;
 				}
@@ -262,6 +267,7 @@ int cmd_window(char **args, int num)
 			direction_t dir;
 			if (!parse_direction(*args, &dir))
 				return MSG_FAILURE;
+			update_layout(trg.monitor, trg.desktop);
 			node_t *n = find_fence(trg.node, dir);
 			if (n == NULL)
 				return MSG_FAILURE;
@@ -285,6 +291,7 @@ int cmd_window(char **args, int num)
 				else
 					return MSG_FAILURE;
 			}
+			invalidate_layout(n);
 			dirty = true;
 		} else if (streq("-r", *args) || streq("--ratio", *args)) {
 			num--, args++;
@@ -293,7 +300,7 @@ int cmd_window(char **args, int num)
 			double rat;
 			if (sscanf(*args, "%lf", &rat) == 1 && rat > 0 && rat < 1) {
 				trg.node->split_ratio = rat;
-				window_draw_border(trg.node, trg.desktop->focus == trg.node, mon == trg.monitor);
+				invalidate_border(trg.node);
 			} else {
 				return MSG_FAILURE;
 			}
@@ -304,6 +311,7 @@ int cmd_window(char **args, int num)
 			direction_t dir;
 			if (!parse_direction(*args, &dir))
 				return MSG_FAILURE;
+			update_layout(trg.monitor, trg.desktop);
 			node_t *n = find_fence(trg.node, dir);
 			if (n == NULL)
 				return MSG_FAILURE;
@@ -433,9 +441,7 @@ int cmd_desktop(char **args, int num)
 			num--, args++;
 			if (num < 1)
 				return MSG_SYNTAX;
-			put_status(SBSC_MASK_DESKTOP_RENAME, "desktop_rename %s %s %s\n", trg.monitor->name, trg.desktop->name, *args);
-			snprintf(trg.desktop->name, sizeof(trg.desktop->name), "%s", *args);
-			ewmh_update_desktop_names();
+			rename_desktop(trg.monitor, trg.desktop, *args);
 			put_status(SBSC_MASK_REPORT);
 		} else if (streq("-r", *args) || streq("--remove", *args)) {
 			if (trg.desktop->root == NULL &&
@@ -554,8 +560,7 @@ int cmd_monitor(char **args, int num)
 				return MSG_SYNTAX;
 			desktop_t *d = trg.monitor->desk_head;
 			while (num > 0 && d != NULL) {
-				put_status(SBSC_MASK_DESKTOP_RENAME, "desktop_rename %s %s %s\n", trg.monitor->name, d->name, *args);
-				snprintf(d->name, sizeof(d->name), "%s", *args);
+				rename_desktop(trg.monitor, d, *args);
 				initialize_desktop(d);
 				arrange(trg.monitor, d);
 				d = d->next;
@@ -614,8 +619,7 @@ int cmd_monitor(char **args, int num)
 			num--, args++;
 			if (num < 1)
 				return MSG_SYNTAX;
-			put_status(SBSC_MASK_MONITOR_RENAME, "monitor_rename %s %s\n", trg.monitor->name, *args);
-			snprintf(trg.monitor->name, sizeof(trg.monitor->name), "%s", *args);
+			rename_monitor(trg.monitor, *args);
 			put_status(SBSC_MASK_REPORT);
 		} else if (streq("-s", *args) || streq("--swap", *args)) {
 			num--, args++;
@@ -640,6 +644,7 @@ int cmd_query(char **args, int num, FILE *rsp)
 	coordinates_t ref = {mon, mon->desk, mon->desk->focus};
 	coordinates_t trg = {NULL, NULL, NULL};
 	domain_t dom = DOMAIN_TREE;
+	bool json = false;
 	int d = 0, t = 0;
 
 	while (num > 0) {
@@ -655,6 +660,12 @@ int cmd_query(char **args, int num, FILE *rsp)
 			dom = DOMAIN_HISTORY, d++;
 		} else if (streq("-S", *args) || streq("--stack", *args)) {
 			dom = DOMAIN_STACK, d++;
+		} else if (streq("--subscribers", *args)) {
+			dom = DOMAIN_SUBSCRIBER, d++;
+		} else if (streq("--stats", *args)) {
+			dom = DOMAIN_STATS, d++;
+		} else if (streq("--json", *args)) {
+			json = true;
 		} else if (streq("-m", *args) || streq("--monitor", *args)) {
 			trg.monitor = ref.monitor;
 			if (num > 1 && *(args + 1)[0] != OPT_CHR) {
@@ -689,10 +700,19 @@ int cmd_query(char **args, int num, FILE *rsp)
 	if (d != 1 || t > 1)
 		return MSG_SYNTAX;
 
-	if (dom == DOMAIN_HISTORY)
+	if (json && (dom == DOMAIN_SUBSCRIBER || dom == DOMAIN_STATS))
+		return MSG_SYNTAX;
+
+	if (json)
+		query_json(trg, dom, rsp);
+	else if (dom == DOMAIN_HISTORY)
 		query_history(trg, rsp);
 	else if (dom == DOMAIN_STACK)
 		query_stack(rsp);
+	else if (dom == DOMAIN_SUBSCRIBER)
+		query_subscribers(rsp);
+	else if (dom == DOMAIN_STATS)
+		print_stats(rsp);
 	else if (dom == DOMAIN_WINDOW)
 		query_windows(trg, rsp);
 	else
@@ -848,6 +868,8 @@ int cmd_control(char **args, int num, FILE *rsp)
 			return MSG_SUBSCRIBE;
 		} else if (streq("--get-status", *args)) {
 			print_report(rsp);
+		} else if (streq("--reset-stats", *args)) {
+			reset_stats();
 		} else if (streq("--record-history", *args)) {
 			num--, args++;
 			if (num < 1)
@@ -988,7 +1010,10 @@ int set_setting(coordinates_t loc, char *name, char *value)
 		return MSG_SUCCESS;
 #define SETCOLOR(s) \
 	} else if (streq(#s, name)) { \
-		snprintf(s, sizeof(s), "%s", value);
+		char old[MAXLEN]; \
+		snprintf(old, sizeof(old), "%s", s); \
+		snprintf(s, sizeof(s), "%s", value); \
+		update_color(old, s);
 	SETCOLOR(focused_border_color)
 	SETCOLOR(active_border_color)
 	SETCOLOR(normal_border_color)
@@ -1011,6 +1036,24 @@ int set_setting(coordinates_t loc, char *name, char *value)
 		} else {
 			return MSG_FAILURE;
 		}
+	} else if (streq("subscriber_overflow", name)) {
+		overflow_policy_t p;
+		if (parse_overflow_policy(value, &p))
+			subscriber_overflow = p;
+		else
+			return MSG_FAILURE;
+		return MSG_SUCCESS;
+#define SETUINT(s) \
+	} else if (streq(#s, name)) { \
+		unsigned int u; \
+		if (sscanf(value, "%u", &u) == 1) \
+			s = u; \
+		else \
+			return MSG_FAILURE; \
+		return MSG_SUCCESS;
+	SETUINT(external_rules_timeout)
+	SETUINT(external_rules_max_running)
+#undef SETUINT
 	} else if (streq("focus_follows_pointer", name)) {
 		bool b;
 		if (parse_bool(value, &b) && b != focus_follows_pointer) {
@@ -1019,7 +1062,7 @@ int set_setting(coordinates_t loc, char *name, char *value)
 			for (monitor_t *m = mon_head; m != NULL; m = m->next) {
 				for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
 					for (node_t *n = first_extrema(d->root); n != NULL; n = next_leaf(n, d->root)) {
-						xcb_change_window_attributes(dpy, n->client->window, XCB_CW_EVENT_MASK, values);
+						backend->change_window_attributes(n->client->window, XCB_CW_EVENT_MASK, values);
 					}
 				}
 			}
@@ -1052,6 +1095,7 @@ int set_setting(coordinates_t loc, char *name, char *value)
 		SETBOOL(history_aware_focus)
 		SETBOOL(focus_by_distance)
 		SETBOOL(ignore_ewmh_focus)
+		SETBOOL(external_rules_persistent)
 		SETBOOL(center_pseudo_tiled)
 #undef SETBOOL
 #define SETMONBOOL(s) \
@@ -1068,9 +1112,15 @@ int set_setting(coordinates_t loc, char *name, char *value)
 		return MSG_FAILURE;
 	}
 
+	/* the next request will start the new command */
+	if (streq("external_rules_command", name) || streq("external_rules_persistent", name))
+		stop_rule_coprocess();
+
 	for (monitor_t *m = mon_head; m != NULL; m = m->next)
-		for (desktop_t *d = m->desk_head; d != NULL; d = d->next)
+		for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
+			invalidate_tree(d->root);
 			arrange(m, d);
+		}
 
 	return MSG_SUCCESS;
 }
@@ -1099,6 +1149,12 @@ int get_setting(coordinates_t loc, char *name, FILE* rsp)
 		fprintf(rsp, "%s", status_prefix);
 	else if (streq("initial_polarity", name))
 		fprintf(rsp, "%s", initial_polarity == FIRST_CHILD ? "first_child" : "second_child");
+	else if (streq("subscriber_overflow", name))
+		fprintf(rsp, "%s", subscriber_overflow == OVERFLOW_DROP_OLDEST ? "drop_oldest" : (subscriber_overflow == OVERFLOW_COALESCE ? "coalesce" : "disconnect"));
+	else if (streq("external_rules_timeout", name))
+		fprintf(rsp, "%u", external_rules_timeout);
+	else if (streq("external_rules_max_running", name))
+		fprintf(rsp, "%u", external_rules_max_running);
 #define MONDESKGET(k) \
 	else if (streq(#k, name)) \
 		if (loc.desktop != NULL) \
@@ -1142,6 +1198,7 @@ int get_setting(coordinates_t loc, char *name, FILE* rsp)
 	GETBOOL(history_aware_focus)
 	GETBOOL(focus_by_distance)
 	GETBOOL(ignore_ewmh_focus)
+	GETBOOL(external_rules_persistent)
 	GETBOOL(center_pseudo_tiled)
 	GETBOOL(remove_disabled_monitors)
 	GETBOOL(remove_unplugged_monitors)
@@ -1334,6 +1391,21 @@ bool parse_child_polarity(char *s, child_polarity_t *p)
 	return false;
 }
 
+bool parse_overflow_policy(char *s, overflow_policy_t *p)
+{
+	if (streq("drop_oldest", s)) {
+		*p = OVERFLOW_DROP_OLDEST;
+		return true;
+	} else if (streq("coalesce", s)) {
+		*p = OVERFLOW_COALESCE;
+		return true;
+	} else if (streq("disconnect", s)) {
+		*p = OVERFLOW_DISCONNECT;
+		return true;
+	}
+	return false;
+}
+
 bool parse_degree(char *s, int *d)
 {
 	int i = atoi(s);
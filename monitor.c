@@ -26,6 +26,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "bspwm.h"
+#include "backend.h"
 #include "desktop.h"
 #include "ewmh.h"
 #include "history.h"
@@ -34,6 +35,7 @@
 #include "tree.h"
 #include "subscribe.h"
 #include "window.h"
+#include "lookup.h"
 #include "monitor.h"
 
 monitor_t *make_monitor(xcb_rectangle_t rect)
@@ -47,8 +49,8 @@ monitor_t *make_monitor(xcb_rectangle_t rect)
 	m->wired = true;
 	m->num_sticky = 0;
 	uint32_t values[] = {XCB_EVENT_MASK_ENTER_WINDOW};
-	m->root = xcb_generate_id(dpy);
-	xcb_create_window(dpy, XCB_COPY_FROM_PARENT, m->root, root, rect.x, rect.y, rect.width, rect.height, 0, XCB_WINDOW_CLASS_INPUT_ONLY, XCB_COPY_FROM_PARENT, XCB_CW_EVENT_MASK, values);
+	m->root = backend->generate_id();
+	backend->create_window(m->root, root, rect, XCB_WINDOW_CLASS_INPUT_ONLY, XCB_CW_EVENT_MASK, values);
 	window_lower(m->root);
 	if (focus_follows_pointer) {
 		window_show(m->root);
@@ -58,10 +60,7 @@ monitor_t *make_monitor(xcb_rectangle_t rect)
 
 monitor_t *find_monitor(char *name)
 {
-	for (monitor_t *m = mon_head; m != NULL; m = m->next)
-		if (streq(m->name, name))
-			return m;
-	return NULL;
+	return lookup_monitor(name);
 }
 
 monitor_t *get_monitor_by_id(xcb_randr_output_t id)
@@ -159,9 +158,17 @@ monitor_t *add_monitor(xcb_rectangle_t rect)
 	}
 
 	num_monitors++;
+	invalidate_lookup();
 	return m;
 }
 
+void rename_monitor(monitor_t *m, const char *name)
+{
+	put_status(SBSC_MASK_MONITOR_RENAME, "monitor_rename %s %s\n", m->name, name);
+	snprintf(m->name, sizeof(m->name), "%s", name);
+	invalidate_lookup();
+}
+
 void remove_monitor(monitor_t *m)
 {
 	PRINTF("remove monitor %s (0x%X)\n", m->name, m->id);
@@ -187,9 +194,10 @@ void remove_monitor(monitor_t *m)
 		if (mon != NULL && mon->desk != NULL)
 			update_current();
 	}
-	xcb_destroy_window(dpy, m->root);
+	backend->destroy_window(m->root);
 	free(m);
 	num_monitors--;
+	invalidate_lookup();
 	put_status(SBSC_MASK_REPORT);
 }
 
@@ -243,6 +251,8 @@ void swap_monitors(monitor_t *m1, monitor_t *m2)
 	m2->prev = p1 == m2 ? m1 : p1;
 	m2->next = n1 == m2 ? m1 : n1;
 
+	invalidate_lookup();
+
 	ewmh_update_wm_desktops();
 	ewmh_update_desktop_names();
 	ewmh_update_current_desktop();
@@ -370,6 +380,7 @@ bool update_monitors(void)
 						char *name = (char *)xcb_randr_get_output_info_name(info);
 						size_t name_len = MIN(sizeof(mm->name), (size_t)xcb_randr_get_output_info_name_length(info) + 1);
 						snprintf(mm->name, name_len, "%s", name);
+						invalidate_lookup();
 						mm->id = outputs[i];
 						PRINTF("add monitor %s (0x%X)\n", mm->name, mm->id);
 					}
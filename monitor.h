@@ -35,6 +35,7 @@ void translate_client(monitor_t *ms, monitor_t *md, client_t *c);
 void update_root(monitor_t *m);
 void focus_monitor(monitor_t *m);
 monitor_t *add_monitor(xcb_rectangle_t rect);
+void rename_monitor(monitor_t *m, const char *name);
 void remove_monitor(monitor_t *m);
 void merge_monitors(monitor_t *ms, monitor_t *md);
 void swap_monitors(monitor_t *m1, monitor_t *m2);
@@ -69,6 +69,7 @@ void grab_pointer(pointer_action_t pac)
 			case ACTION_MOVE:
 			case ACTION_RESIZE_SIDE:
 			case ACTION_RESIZE_CORNER:
+				update_layout(loc.monitor, loc.desktop);
 				if (is_floating(c)) {
 					frozen_pointer->rectangle = c->floating_rectangle;
 					frozen_pointer->is_tiled = false;
@@ -223,9 +224,9 @@ void track_pointer(int root_x, int root_y)
 			} else {
 				x = rect.x + delta_x;
 				y = rect.y + delta_y;
-				window_move(win, x, y);
 				c->floating_rectangle.x = x;
 				c->floating_rectangle.y = y;
+				window_configure(c, c->floating_rectangle, c->border_width);
 				xcb_point_t pt = (xcb_point_t) {root_x, root_y};
 				monitor_t *pmon = monitor_from_point(pt);
 				if (pmon == NULL || pmon == m)
@@ -246,12 +247,14 @@ void track_pointer(int root_x, int root_y)
 					sr = MAX(0, sr);
 					sr = MIN(1, sr);
 					vertical_fence->split_ratio = sr;
+					invalidate_layout(vertical_fence);
 				}
 				if (horizontal_fence != NULL) {
 					double sr = frozen_pointer->horizontal_ratio + (double) delta_y / horizontal_fence->rectangle.height;
 					sr = MAX(0, sr);
 					sr = MIN(1, sr);
 					horizontal_fence->split_ratio = sr;
+					invalidate_layout(horizontal_fence);
 				}
 				arrange(m, d);
 			} else {
@@ -317,6 +320,7 @@ void track_pointer(int root_x, int root_y)
 				if (c->pseudo_tiled) {
 					c->floating_rectangle.width = w;
 					c->floating_rectangle.height = h;
+					invalidate_layout(n);
 					arrange(m, d);
 				} else {
 					if (oldw == w) {
@@ -327,10 +331,7 @@ void track_pointer(int root_x, int root_y)
 						c->floating_rectangle.y = y;
 						c->floating_rectangle.height = h;
 					}
-					window_move_resize(win, c->floating_rectangle.x,
-					                        c->floating_rectangle.y,
-					                        c->floating_rectangle.width,
-					                        c->floating_rectangle.height);
+					window_configure(c, c->floating_rectangle, c->border_width);
 				}
 			}
 			break;
@@ -30,7 +30,10 @@
 #include "history.h"
 #include "messages.h"
 #include "monitor.h"
+#include "stack.h"
 #include "tree.h"
+#include "lookup.h"
+#include "wintable.h"
 #include "query.h"
 
 void query_monitors(coordinates_t loc, domain_t dom, FILE *rsp)
@@ -118,10 +121,17 @@ void query_history(coordinates_t loc, FILE *rsp)
 
 void query_stack(FILE *rsp)
 {
-	for (stacking_list_t *s = stack_head; s != NULL; s = s->next)
+	for (stacking_list_t *s = stack_bottom(); s != NULL; s = stack_next(s))
 		fprintf(rsp, "0x%X\n", s->node->client->window);
 }
 
+void query_subscribers(FILE *rsp)
+{
+	for (subscriber_list_t *sb = subscribe_head; sb != NULL; sb = sb->next)
+		fprintf(rsp, "%i queued %u sent %lu dropped %lu coalesced %lu duplicates %lu\n", sb->fd, sb->count, sb->sent, sb->dropped, sb->coalesced, sb->duplicates);
+	fprintf(rsp, "overflows %lu\n", subscribe_overflows);
+}
+
 void query_windows(coordinates_t loc, FILE *rsp)
 {
 	for (monitor_t *m = mon_head; m != NULL; m = m->next) {
@@ -139,6 +149,243 @@ void query_windows(coordinates_t loc, FILE *rsp)
 	}
 }
 
+/* Same domains as the text queries, each printed as a JSON array */
+void query_json(coordinates_t loc, domain_t dom, FILE *rsp)
+{
+	/* the rectangles are reported as they'll be committed */
+	for (monitor_t *m = mon_head; m != NULL; m = m->next)
+		for (desktop_t *d = m->desk_head; d != NULL; d = d->next)
+			update_layout(m, d);
+
+	json_writer_t w;
+	json_init(&w, rsp);
+	json_begin_array(&w);
+	if (dom == DOMAIN_HISTORY) {
+		for (history_t *h = history_head; h != NULL; h = h->next) {
+			if ((loc.monitor != NULL && h->loc.monitor != loc.monitor)
+					|| (loc.desktop != NULL && h->loc.desktop != loc.desktop))
+				continue;
+			json_begin_object(&w);
+			json_key(&w, "monitor");
+			json_string(&w, h->loc.monitor->name);
+			json_key(&w, "desktop");
+			json_string(&w, h->loc.desktop->name);
+			json_key(&w, "window");
+			if (h->loc.node != NULL)
+				json_uint(&w, h->loc.node->client->window);
+			else
+				json_null(&w);
+			json_key(&w, "stamp");
+			json_uint(&w, h->stamp);
+			json_end_object(&w);
+		}
+	} else if (dom == DOMAIN_STACK) {
+		char *layers[LAYER_LENGTH] = {"tiled", "floating", "fullscreen"};
+		for (stacking_list_t *s = stack_bottom(); s != NULL; s = stack_next(s)) {
+			json_begin_object(&w);
+			json_key(&w, "window");
+			json_uint(&w, s->node->client->window);
+			json_key(&w, "layer");
+			json_string(&w, layers[s->layer]);
+			json_end_object(&w);
+		}
+	} else {
+		for (monitor_t *m = mon_head; m != NULL; m = m->next) {
+			if (loc.monitor != NULL && m != loc.monitor)
+				continue;
+			if (dom == DOMAIN_MONITOR || dom == DOMAIN_TREE) {
+				json_monitor(&w, m, loc, dom == DOMAIN_TREE);
+				continue;
+			}
+			for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
+				if (loc.desktop != NULL && d != loc.desktop)
+					continue;
+				if (dom == DOMAIN_DESKTOP) {
+					json_desktop(&w, d, loc, false);
+					continue;
+				}
+				for (node_t *n = first_extrema(d->root); n != NULL; n = next_leaf(n, d->root))
+					if (loc.node == NULL || n == loc.node)
+						json_node(&w, d, n, false);
+			}
+		}
+	}
+	json_end_array(&w);
+	fprintf(rsp, "\n");
+}
+
+void json_monitor(json_writer_t *w, monitor_t *m, coordinates_t loc, bool tree)
+{
+	json_begin_object(w);
+	json_key(w, "name");
+	json_string(w, m->name);
+	json_key(w, "id");
+	json_uint(w, m->id);
+	json_key(w, "rectangle");
+	json_rectangle(w, m->rectangle);
+	json_key(w, "padding");
+	json_padding(w, m->top_padding, m->right_padding, m->bottom_padding, m->left_padding);
+	json_key(w, "wired");
+	json_bool(w, m->wired);
+	json_key(w, "focused");
+	json_bool(w, m == mon);
+	json_key(w, "primary");
+	json_bool(w, m == pri_mon);
+	json_key(w, "sticky_count");
+	json_int(w, m->num_sticky);
+	json_key(w, "focused_desktop");
+	if (m->desk != NULL)
+		json_string(w, m->desk->name);
+	else
+		json_null(w);
+	if (tree) {
+		json_key(w, "desktops");
+		json_begin_array(w);
+		for (desktop_t *d = m->desk_head; d != NULL; d = d->next)
+			if (loc.desktop == NULL || d == loc.desktop)
+				json_desktop(w, d, loc, true);
+		json_end_array(w);
+	}
+	json_end_object(w);
+}
+
+void json_desktop(json_writer_t *w, desktop_t *d, coordinates_t loc, bool tree)
+{
+	json_begin_object(w);
+	json_key(w, "name");
+	json_string(w, d->name);
+	json_key(w, "monitor");
+	json_string(w, d->monitor->name);
+	json_key(w, "layout");
+	json_string(w, d->layout == LAYOUT_TILED ? "tiled" : "monocle");
+	json_key(w, "focused");
+	json_bool(w, d == d->monitor->desk);
+	json_key(w, "floating");
+	json_bool(w, d->floating);
+	json_key(w, "border_width");
+	json_uint(w, d->border_width);
+	json_key(w, "window_gap");
+	json_int(w, d->window_gap);
+	json_key(w, "padding");
+	json_padding(w, d->top_padding, d->right_padding, d->bottom_padding, d->left_padding);
+	json_key(w, "client_count");
+	json_uint(w, d->client_count);
+	json_key(w, "urgent_count");
+	json_uint(w, d->urgent_count);
+	json_key(w, "focused_window");
+	if (d->focus != NULL)
+		json_uint(w, d->focus->client->window);
+	else
+		json_null(w);
+	if (tree) {
+		json_key(w, "root");
+		if (loc.node != NULL)
+			json_node(w, d, loc.node, true);
+		else if (d->root != NULL)
+			json_node(w, d, d->root, true);
+		else
+			json_null(w);
+	}
+	json_end_object(w);
+}
+
+void json_node(json_writer_t *w, desktop_t *d, node_t *n, bool tree)
+{
+	char *dirs[] = {"right", "down", "left", "up"};
+	json_begin_object(w);
+	json_key(w, "split_type");
+	json_string(w, n->split_type == TYPE_HORIZONTAL ? "horizontal" : "vertical");
+	json_key(w, "split_ratio");
+	json_double(w, n->split_ratio);
+	json_key(w, "split_mode");
+	json_string(w, n->split_mode == MODE_MANUAL ? "manual" : "automatic");
+	json_key(w, "split_dir");
+	if (n->split_mode == MODE_MANUAL)
+		json_string(w, dirs[n->split_dir]);
+	else
+		json_null(w);
+	json_key(w, "birth_rotation");
+	json_int(w, n->birth_rotation);
+	json_key(w, "rectangle");
+	json_rectangle(w, n->rectangle);
+	json_key(w, "vacant");
+	json_bool(w, n->vacant);
+	json_key(w, "privacy_level");
+	json_int(w, n->privacy_level);
+	json_key(w, "focused");
+	json_bool(w, n == d->focus);
+	json_key(w, "client");
+	if (n->client != NULL)
+		json_client(w, n->client);
+	else
+		json_null(w);
+	if (tree) {
+		json_key(w, "first_child");
+		if (n->first_child != NULL)
+			json_node(w, d, n->first_child, true);
+		else
+			json_null(w);
+		json_key(w, "second_child");
+		if (n->second_child != NULL)
+			json_node(w, d, n->second_child, true);
+		else
+			json_null(w);
+	}
+	json_end_object(w);
+}
+
+void json_client(json_writer_t *w, client_t *c)
+{
+	json_begin_object(w);
+	json_key(w, "window");
+	json_uint(w, c->window);
+	json_key(w, "class_name");
+	json_string(w, c->class_name);
+	json_key(w, "instance_name");
+	json_string(w, c->instance_name);
+	json_key(w, "border_width");
+	json_uint(w, c->border_width);
+#define JSONBOOL(k) \
+	json_key(w, #k); \
+	json_bool(w, c->k);
+	JSONBOOL(pseudo_tiled)
+	JSONBOOL(floating)
+	JSONBOOL(fullscreen)
+	JSONBOOL(locked)
+	JSONBOOL(sticky)
+	JSONBOOL(urgent)
+	JSONBOOL(private)
+	JSONBOOL(icccm_focus)
+#undef JSONBOOL
+	json_key(w, "floating_rectangle");
+	json_rectangle(w, c->floating_rectangle);
+	json_key(w, "tiled_rectangle");
+	json_rectangle(w, c->tiled_rectangle);
+	json_key(w, "min_width");
+	json_uint(w, c->min_width);
+	json_key(w, "max_width");
+	json_uint(w, c->max_width);
+	json_key(w, "min_height");
+	json_uint(w, c->min_height);
+	json_key(w, "max_height");
+	json_uint(w, c->max_height);
+	json_end_object(w);
+}
+
+void json_padding(json_writer_t *w, int top, int right, int bottom, int left)
+{
+	json_begin_object(w);
+	json_key(w, "top");
+	json_int(w, top);
+	json_key(w, "right");
+	json_int(w, right);
+	json_key(w, "bottom");
+	json_int(w, bottom);
+	json_key(w, "left");
+	json_int(w, left);
+	json_end_object(w);
+}
+
 bool node_from_desc(char *desc, coordinates_t *ref, coordinates_t *dst)
 {
 	client_select_t sel = {CLIENT_TYPE_ALL, CLIENT_CLASS_ALL, CLIENT_MODE_ALL, false, false, false};
@@ -315,66 +562,66 @@ bool monitor_from_desc(char *desc, coordinates_t *ref, coordinates_t *dst)
 
 bool locate_window(xcb_window_t win, coordinates_t *loc)
 {
-	for (monitor_t *m = mon_head; m != NULL; m = m->next)
-		for (desktop_t *d = m->desk_head; d != NULL; d = d->next)
-			for (node_t *n = first_extrema(d->root); n != NULL; n = next_leaf(n, d->root))
-				if (n->client->window == win) {
-					loc->monitor = m;
-					loc->desktop = d;
-					loc->node = n;
-					return true;
-				}
-	return false;
+	window_entry_t *we = wintable_find(win);
+	if (we == NULL || we->node == NULL)
+		return false;
+	loc->monitor = we->desktop->monitor;
+	loc->desktop = we->desktop;
+	loc->node = we->node;
+	return true;
 }
 
 bool locate_desktop(char *name, coordinates_t *loc)
 {
-	for (monitor_t *m = mon_head; m != NULL; m = m->next)
-		for (desktop_t *d = m->desk_head; d != NULL; d = d->next)
-			if (streq(d->name, name)) {
-				loc->monitor = m;
-				loc->desktop = d;
-				return true;
-			}
-	return false;
+	desktop_t *d = lookup_desktop(name);
+	if (d == NULL)
+		return false;
+	loc->monitor = d->monitor;
+	loc->desktop = d;
+	return true;
 }
 
 bool locate_monitor(char *name, coordinates_t *loc)
 {
-	for (monitor_t *m = mon_head; m != NULL; m = m->next)
-		if (streq(m->name, name)) {
-			loc->monitor = m;
-			return true;
-		}
-	return false;
+	monitor_t *m = lookup_monitor(name);
+	if (m == NULL)
+		return false;
+	loc->monitor = m;
+	return true;
 }
 
 bool desktop_from_index(int i, coordinates_t *loc, monitor_t *mm)
 {
-	for (monitor_t *m = mon_head; m != NULL; m = m->next) {
-		if (mm != NULL && m != mm)
-			continue;
-		for (desktop_t *d = m->desk_head; d != NULL; d = d->next, i--)
-			if (i == 1) {
-				loc->monitor = m;
-				loc->desktop = d;
-				loc->node = NULL;
-				return true;
-			}
+	if (i < 1)
+		return false;
+	desktop_t *d;
+	if (mm != NULL) {
+		update_lookup();
+		if ((unsigned int) i > mm->desk_count)
+			return false;
+		d = desktop_at(mm->desk_index + i - 1);
+	} else {
+		d = desktop_at(i - 1);
 	}
-	return false;
+	if (d == NULL)
+		return false;
+	loc->monitor = d->monitor;
+	loc->desktop = d;
+	loc->node = NULL;
+	return true;
 }
 
 bool monitor_from_index(int i, coordinates_t *loc)
 {
-	for (monitor_t *m = mon_head; m != NULL; m = m->next, i--)
-		if (i == 1) {
-			loc->monitor = m;
-			loc->desktop = NULL;
-			loc->node = NULL;
-			return true;
-		}
-	return false;
+	if (i < 1)
+		return false;
+	monitor_t *m = monitor_at(i - 1);
+	if (m == NULL)
+		return false;
+	loc->monitor = m;
+	loc->desktop = NULL;
+	loc->node = NULL;
+	return true;
 }
 
 bool node_matches(coordinates_t *loc, coordinates_t *ref, client_select_t sel)
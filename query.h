@@ -25,13 +25,17 @@
 #ifndef BSPWM_QUERY_H
 #define BSPWM_QUERY_H
 
+#include "json.h"
+
 typedef enum {
 	DOMAIN_MONITOR,
 	DOMAIN_DESKTOP,
 	DOMAIN_WINDOW,
 	DOMAIN_TREE,
 	DOMAIN_HISTORY,
-	DOMAIN_STACK
+	DOMAIN_STACK,
+	DOMAIN_SUBSCRIBER,
+	DOMAIN_STATS
 } domain_t;
 
 void query_monitors(coordinates_t loc, domain_t dom, FILE *rsp);
@@ -39,7 +43,14 @@ void query_desktops(monitor_t *m, domain_t dom, coordinates_t loc, unsigned int
 void query_tree(desktop_t *d, node_t *n, FILE *rsp, unsigned int depth);
 void query_history(coordinates_t loc, FILE *rsp);
 void query_stack(FILE *rsp);
+void query_subscribers(FILE *rsp);
 void query_windows(coordinates_t loc, FILE *rsp);
+void query_json(coordinates_t loc, domain_t dom, FILE *rsp);
+void json_monitor(json_writer_t *w, monitor_t *m, coordinates_t loc, bool tree);
+void json_desktop(json_writer_t *w, desktop_t *d, coordinates_t loc, bool tree);
+void json_node(json_writer_t *w, desktop_t *d, node_t *n, bool tree);
+void json_client(json_writer_t *w, client_t *c);
+void json_padding(json_writer_t *w, int top, int right, int bottom, int left);
 bool node_from_desc(char *desc, coordinates_t *ref, coordinates_t *dst);
 bool desktop_from_desc(char *desc, coordinates_t *ref, coordinates_t *dst);
 bool monitor_from_desc(char *desc, coordinates_t *ref, coordinates_t *dst);
@@ -23,8 +23,10 @@
  */
 
 #include <ctype.h>
+#include <stdlib.h>
 #include <string.h>
 #include "bspwm.h"
+#include "backend.h"
 #include "desktop.h"
 #include "ewmh.h"
 #include "history.h"
@@ -33,6 +35,8 @@
 #include "stack.h"
 #include "tree.h"
 #include "settings.h"
+#include "window.h"
+#include "wintable.h"
 #include "restore.h"
 
 void restore_tree(char *file_path)
@@ -181,10 +185,15 @@ void restore_tree(char *file_path)
 	fclose(snapshot);
 
 	for (monitor_t *m = mon_head; m != NULL; m = m->next)
-		for (desktop_t *d = m->desk_head; d != NULL; d = d->next)
+		for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
+			d->client_count = d->urgent_count = 0;
 			for (node_t *n = first_extrema(d->root); n != NULL; n = next_leaf(n, d->root)) {
+				wintable_add_node(d, n);
+				d->client_count++;
+				if (n->client->urgent)
+					d->urgent_count++;
 				uint32_t values[] = {CLIENT_EVENT_MASK | (focus_follows_pointer ? XCB_EVENT_MASK_ENTER_WINDOW : 0)};
-				xcb_change_window_attributes(dpy, n->client->window, XCB_CW_EVENT_MASK, values);
+				backend->change_window_attributes(n->client->window, XCB_CW_EVENT_MASK, values);
 				if (n->client->floating) {
 					n->vacant = true;
 					update_vacant_state(n->parent);
@@ -192,9 +201,49 @@ void restore_tree(char *file_path)
 				if (n->client->private)
 					update_privacy_level(n, true);
 			}
+		}
+	restore_visuals();
 	ewmh_update_current_desktop();
 }
 
+/* The restored clients didn't go through schedule_window: fetch their depth
+ * and colormap, sending every request before waiting for any reply. */
+void restore_visuals(void)
+{
+	unsigned int count = 0;
+	for (monitor_t *m = mon_head; m != NULL; m = m->next)
+		for (desktop_t *d = m->desk_head; d != NULL; d = d->next)
+			count += d->client_count;
+	if (count == 0)
+		return;
+
+	xcb_get_geometry_cookie_t geometries[count];
+	xcb_get_window_attributes_cookie_t attributes[count];
+	unsigned int i = 0;
+	for (monitor_t *m = mon_head; m != NULL; m = m->next)
+		for (desktop_t *d = m->desk_head; d != NULL; d = d->next)
+			for (node_t *n = first_extrema(d->root); n != NULL; n = next_leaf(n, d->root), i++) {
+				geometries[i] = xcb_get_geometry(dpy, n->client->window);
+				attributes[i] = xcb_get_window_attributes(dpy, n->client->window);
+			}
+
+	i = 0;
+	for (monitor_t *m = mon_head; m != NULL; m = m->next)
+		for (desktop_t *d = m->desk_head; d != NULL; d = d->next)
+			for (node_t *n = first_extrema(d->root); n != NULL; n = next_leaf(n, d->root), i++) {
+				client_t *c = n->client;
+				xcb_get_geometry_reply_t *geo = xcb_get_geometry_reply(dpy, geometries[i], NULL);
+				if (geo != NULL)
+					c->depth = geo->depth;
+				free(geo);
+				xcb_get_window_attributes_reply_t *wa = xcb_get_window_attributes_reply(dpy, attributes[i], NULL);
+				if (wa != NULL)
+					c->colormap = wa->colormap;
+				free(wa);
+				cache_border_colors(c->colormap);
+			}
+}
+
 void restore_history(char *file_path)
 {
 	if (file_path == NULL)
@@ -260,7 +309,7 @@ void restore_stack(char *file_path)
 		if (sscanf(line, "%X", &win) == 1) {
 			coordinates_t loc;
 			if (locate_window(win, &loc))
-				stack_insert_after(stack_tail, loc.node);
+				stack_insert_after(stack_tail[stack_layer(loc.node->client)], loc.node);
 			else
 				warn("Can't locate window 0x%X.\n", win);
 		} else {
@@ -26,6 +26,7 @@
 #define BSPWM_RESTORE_H
 
 void restore_tree(char *file_path);
+void restore_visuals(void);
 void restore_history(char *file_path);
 void restore_stack(char *file_path);
 
@@ -24,12 +24,18 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
+#include <signal.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
 #include "bspwm.h"
 #include "ewmh.h"
 #include "window.h"
 #include "messages.h"
 #include "settings.h"
+#include "stats.h"
+#include "wintable.h"
 #include "rule.h"
 
 rule_t *make_rule(void)
@@ -37,12 +43,24 @@ rule_t *make_rule(void)
 	rule_t *r = malloc(sizeof(rule_t));
 	r->cause[0] = r->effect[0] = '\0';
 	r->next = r->prev = NULL;
+	r->cause_next = r->cause_prev = NULL;
 	r->one_shot = false;
+	r->order = 0;
+	r->delta = (rule_delta_t) {0, 0, NULL, NULL, NULL, DIR_RIGHT, 0};
 	return r;
 }
 
 void add_rule(rule_t *r)
  {
+	rule_cause_t *rc = get_rule_cause(r->cause);
+	if (rc == NULL) {
+		free(r);
+		return;
+	}
+	r->order = ++rule_order;
+	char effect[MAXLEN];
+	snprintf(effect, sizeof(effect), "%s", r->effect);
+	compile_rule_effect(effect, &r->delta);
 	if (rule_head == NULL) {
 		rule_head = rule_tail = r;
 	} else {
@@ -50,6 +68,13 @@ void add_rule(rule_t *r)
 		r->prev = rule_tail;
 		rule_tail = r;
 	}
+	if (rc->head == NULL) {
+		rc->head = rc->tail = r;
+	} else {
+		rc->tail->cause_next = r;
+		r->cause_prev = rc->tail;
+		rc->tail = r;
+	}
 }
 
 void remove_rule(rule_t *r)
@@ -66,16 +91,112 @@ void remove_rule(rule_t *r)
 		rule_head = next;
 	if (r == rule_tail)
 		rule_tail = prev;
+	rule_cause_t *rc = find_rule_cause(r->cause);
+	if (rc != NULL) {
+		if (r->cause_prev != NULL)
+			r->cause_prev->cause_next = r->cause_next;
+		if (r->cause_next != NULL)
+			r->cause_next->cause_prev = r->cause_prev;
+		if (r == rc->head)
+			rc->head = r->cause_next;
+		if (r == rc->tail)
+			rc->tail = r->cause_prev;
+		if (rc->head == NULL)
+			release_rule_cause(rc, r->cause);
+	}
+	free_rule_delta(&r->delta);
 	free(r);
 }
 
+/* FNV-1a */
+unsigned int rule_hash(const char *cause)
+{
+	uint32_t h = 2166136261u;
+	for (const char *s = cause; *s != '\0'; s++) {
+		h ^= (unsigned char) *s;
+		h *= 16777619;
+	}
+	return h & (rule_table_size - 1);
+}
+
+void rule_table_grow(void)
+{
+	unsigned int size = (rule_table_size == 0 ? RULE_TABLE_MIN_SIZE : 2 * rule_table_size);
+	rule_cause_t **table = calloc(size, sizeof(rule_cause_t *));
+	if (table == NULL) {
+		warn("Couldn't grow the rule table.\n");
+		return;
+	}
+	rule_cause_t **old = rule_table;
+	unsigned int old_size = rule_table_size;
+	rule_table = table;
+	rule_table_size = size;
+	for (unsigned int i = 0; i < old_size; i++) {
+		rule_cause_t *rc = old[i];
+		while (rc != NULL) {
+			rule_cause_t *next = rc->next;
+			unsigned int h = rule_hash(rc->head->cause);
+			rc->next = rule_table[h];
+			rule_table[h] = rc;
+			rc = next;
+		}
+	}
+	free(old);
+}
+
+rule_cause_t *find_rule_cause(const char *cause)
+{
+	if (rule_table_size == 0)
+		return NULL;
+	for (rule_cause_t *rc = rule_table[rule_hash(cause)]; rc != NULL; rc = rc->next)
+		if (streq(rc->head->cause, cause))
+			return rc;
+	return NULL;
+}
+
+/* Returns the entry of the given cause, the caller must give it a rule */
+rule_cause_t *get_rule_cause(const char *cause)
+{
+	rule_cause_t *rc = find_rule_cause(cause);
+	if (rc != NULL)
+		return rc;
+	if (rule_table_count >= rule_table_size)
+		rule_table_grow();
+	if (rule_table_size == 0)
+		return NULL;
+	rc = malloc(sizeof(rule_cause_t));
+	rc->head = rc->tail = NULL;
+	unsigned int h = rule_hash(cause);
+	rc->next = rule_table[h];
+	rule_table[h] = rc;
+	rule_table_count++;
+	return rc;
+}
+
+/* Drops the entry of the given cause, whose last rule was just unlinked */
+void release_rule_cause(rule_cause_t *rc, const char *cause)
+{
+	rule_cause_t **p = &rule_table[rule_hash(cause)];
+	while (*p != NULL) {
+		if (*p == rc) {
+			*p = rc->next;
+			free(rc);
+			rule_table_count--;
+			return;
+		}
+		p = &(*p)->next;
+	}
+}
+
 void remove_rule_by_cause(char *cause)
 {
-	rule_t *r = rule_head;
+	rule_cause_t *rc = find_rule_cause(cause);
+	if (rc == NULL)
+		return;
+	rule_t *r = rc->head;
 	while (r != NULL) {
-		rule_t *next = r->next;
-		if (streq(r->cause, cause))
-			remove_rule(r);
+		rule_t *next = r->cause_next;
+		remove_rule(r);
 		r = next;
 	}
 }
@@ -102,8 +223,13 @@ pending_rule_t *make_pending_rule(int fd, xcb_window_t win, rule_consequence_t *
 	pending_rule_t *pr = malloc(sizeof(pending_rule_t));
 	pr->prev = pr->next = NULL;
 	pr->fd = fd;
+	pr->id = 0;
+	pr->pid = 0;
+	pr->queued = false;
 	pr->win = win;
 	pr->csq = csq;
+	pr->len = 0;
+	pr->watch = (watch_t) {WATCH_RULE, pr};
 	return pr;
 }
 
@@ -112,6 +238,7 @@ void add_pending_rule(pending_rule_t *pr)
 	if (pr == NULL)
 		return;
 	PRINTF("add pending rule %i\n", pr->fd);
+	stats_clock(&pr->started);
 	if (pending_rule_head == NULL) {
 		pending_rule_head = pending_rule_tail = pr;
 	} else {
@@ -119,6 +246,11 @@ void add_pending_rule(pending_rule_t *pr)
 		pr->prev = pending_rule_tail;
 		pending_rule_tail = pr;
 	}
+	wintable_add_rule(pr);
+	if (pr->fd != -1) {
+		watch_fd(pr->fd, EPOLLIN, &pr->watch);
+		running_rules++;
+	}
 }
 
 void remove_pending_rule(pending_rule_t *pr)
@@ -126,26 +258,109 @@ void remove_pending_rule(pending_rule_t *pr)
 	if (pr == NULL)
 		return;
 	PRINTF("remove pending rule %i\n", pr->fd);
+	pending_rule_t **head = pr->queued ? &queued_rule_head : &pending_rule_head;
+	pending_rule_t **tail = pr->queued ? &queued_rule_tail : &pending_rule_tail;
 	pending_rule_t *a = pr->prev;
 	pending_rule_t *b = pr->next;
 	if (a != NULL)
 		a->next = b;
 	if (b != NULL)
 		b->prev = a;
-	if (pr == pending_rule_head)
-		pending_rule_head = b;
-	if (pr == pending_rule_tail)
-		pending_rule_tail = a;
-	close(pr->fd);
-	free(pr->csq);
+	if (pr == *head)
+		*head = b;
+	if (pr == *tail)
+		*tail = a;
+	pr->prev = pr->next = NULL;
+	wintable_remove_rule(pr);
+	if (pr->fd != -1) {
+		unwatch_fd(pr->fd);
+		close(pr->fd);
+		running_rules--;
+	}
+	free_rule_consequence(pr->csq);
 	free(pr);
 }
 
-void apply_rules(xcb_window_t win, rule_consequence_t *csq)
+void queue_pending_rule(pending_rule_t *pr)
+{
+	PRINTF("queue pending rule 0x%X\n", pr->win);
+	pr->queued = true;
+	if (queued_rule_head == NULL) {
+		queued_rule_head = queued_rule_tail = pr;
+	} else {
+		queued_rule_tail->next = pr;
+		pr->prev = queued_rule_tail;
+		queued_rule_tail = pr;
+	}
+	wintable_add_rule(pr);
+}
+
+/* Starts the queued rules commands, oldest first, while slots are free */
+void run_queued_rules(void)
+{
+	while (queued_rule_head != NULL &&
+	       (external_rules_max_running == 0 || running_rules < external_rules_max_running)) {
+		pending_rule_t *pr = queued_rule_head;
+		queued_rule_head = pr->next;
+		if (queued_rule_head == NULL)
+			queued_rule_tail = NULL;
+		else
+			queued_rule_head->prev = NULL;
+		pr->next = NULL;
+		pr->queued = false;
+		if (spawn_rule_command(pr)) {
+			add_pending_rule(pr);
+		} else {
+			wintable_remove_rule(pr);
+			manage_window(pr->win, pr->csq);
+			free_rule_consequence(pr->csq);
+			free(pr);
+		}
+	}
+}
+
+/* The pending rules are sorted by starting time: only the oldest ones can
+ * be overdue. */
+void expire_pending_rules(void)
+{
+	if (external_rules_timeout == 0)
+		return;
+	while (pending_rule_head != NULL &&
+	       stats_elapsed(&pending_rule_head->started) >= 1000UL * external_rules_timeout) {
+		pending_rule_t *pr = pending_rule_head;
+		warn("The external rules command timed out for 0x%X.\n", pr->win);
+		rule_timeouts++;
+		if (pr->fd == -1) {
+			if (rule_coprocess.pid > 0)
+				kill(rule_coprocess.pid, SIGKILL);
+			stop_rule_coprocess();
+			continue;
+		}
+		/* the command leads its own session: take its children too */
+		if (kill(-pr->pid, SIGKILL) == -1)
+			kill(pr->pid, SIGKILL);
+		manage_window(pr->win, pr->csq);
+		remove_pending_rule(pr);
+	}
+}
+
+/* Milliseconds until the oldest pending rule is overdue, in the format
+ * expected by epoll_wait */
+int next_rule_timeout(void)
+{
+	if (external_rules_timeout == 0 || pending_rule_head == NULL)
+		return -1;
+	unsigned long elapsed = stats_elapsed(&pending_rule_head->started) / 1000;
+	if (elapsed >= external_rules_timeout)
+		return 0;
+	return external_rules_timeout - elapsed;
+}
+
+void apply_rules(xcb_window_t win, rule_consequence_t *csq, prefetch_t *pf)
 {
 	xcb_ewmh_get_atoms_reply_t win_type;
 
-	if (xcb_ewmh_get_wm_window_type_reply(ewmh, xcb_ewmh_get_wm_window_type(ewmh, win), &win_type, NULL) == 1) {
+	if (xcb_ewmh_get_wm_window_type_reply(ewmh, pf->window_type, &win_type, NULL) == 1) {
 		for (unsigned int i = 0; i < win_type.atoms_len; i++) {
 			xcb_atom_t a = win_type.atoms[i];
 			if (a == ewmh->_NET_WM_WINDOW_TYPE_TOOLBAR ||
@@ -164,22 +379,26 @@ void apply_rules(xcb_window_t win, rule_consequence_t *csq)
 		}
 		xcb_ewmh_get_atoms_reply_wipe(&win_type);
 	}
+	pf->window_type.sequence = 0;
 
 	xcb_ewmh_get_atoms_reply_t win_state;
 
-	if (xcb_ewmh_get_wm_state_reply(ewmh, xcb_ewmh_get_wm_state(ewmh, win), &win_state, NULL) == 1) {
+	if (xcb_ewmh_get_wm_state_reply(ewmh, pf->wm_state, &win_state, NULL) == 1) {
 		for (unsigned int i = 0; i < win_state.atoms_len; i++) {
 			xcb_atom_t a = win_state.atoms[i];
 			if (a == ewmh->_NET_WM_STATE_FULLSCREEN)
 				csq->fullscreen = true;
 			else if (a == ewmh->_NET_WM_STATE_STICKY)
 				csq->sticky = true;
+			if (csq->num_states < MAX_STATE)
+				csq->wm_state[csq->num_states++] = a;
 		}
 		xcb_ewmh_get_atoms_reply_wipe(&win_state);
 	}
+	pf->wm_state.sequence = 0;
 
 	xcb_size_hints_t size_hints;
-	if (xcb_icccm_get_wm_normal_hints_reply(dpy, xcb_icccm_get_wm_normal_hints(dpy, win), &size_hints, NULL) == 1) {
+	if (xcb_icccm_get_wm_normal_hints_reply(dpy, pf->normal_hints, &size_hints, NULL) == 1) {
 		if (size_hints.min_width > 0 && size_hints.min_height > 0 &&
 		    size_hints.min_width == size_hints.max_width &&
 		    size_hints.min_height == size_hints.max_height)
@@ -189,38 +408,45 @@ void apply_rules(xcb_window_t win, rule_consequence_t *csq)
 		csq->min_height = size_hints.min_height;
 		csq->max_height = size_hints.max_height;
 	}
+	pf->normal_hints.sequence = 0;
 
 	xcb_window_t transient_for = XCB_NONE;
-	xcb_icccm_get_wm_transient_for_reply(dpy, xcb_icccm_get_wm_transient_for(dpy, win), &transient_for, NULL);
+	xcb_icccm_get_wm_transient_for_reply(dpy, pf->transient_for, &transient_for, NULL);
+	pf->transient_for.sequence = 0;
 	if (transient_for != XCB_NONE)
 		csq->floating = true;
 
 	xcb_icccm_get_wm_class_reply_t reply;
-	if (xcb_icccm_get_wm_class_reply(dpy, xcb_icccm_get_wm_class(dpy, win), &reply, NULL) == 1) {
+	if (xcb_icccm_get_wm_class_reply(dpy, pf->wm_class, &reply, NULL) == 1) {
 		snprintf(csq->class_name, sizeof(csq->class_name), "%s", reply.class_name);
 		snprintf(csq->instance_name, sizeof(csq->instance_name), "%s", reply.instance_name);
 		xcb_icccm_get_wm_class_reply_wipe(&reply);
 	}
+	pf->wm_class.sequence = 0;
 
-	rule_t *rule = rule_head;
-	while (rule != NULL) {
-		rule_t *next = rule->next;
-		if (streq(rule->cause, MATCH_ANY) ||
-		    streq(rule->cause, csq->class_name) ||
-		    streq(rule->cause, csq->instance_name)) {
-			char effect[MAXLEN];
-			snprintf(effect, sizeof(effect), "%s", rule->effect);
-			char *key = strtok(effect, CSQ_BLK);
-			char *value = strtok(NULL, CSQ_BLK);
-			while (key != NULL && value != NULL) {
-				parse_key_value(key, value, csq);
-				key = strtok(NULL, CSQ_BLK);
-				value = strtok(NULL, CSQ_BLK);
-			}
-			if (rule->one_shot)
-				remove_rule(rule);
-		}
-		rule = next;
+	/* merge the rules of the matching causes back into the declaration order */
+	rule_t *heads[3] = {NULL, NULL, NULL};
+	rule_cause_t *rc;
+	if ((rc = find_rule_cause(MATCH_ANY)) != NULL)
+		heads[0] = rc->head;
+	if (!streq(csq->class_name, MATCH_ANY) && (rc = find_rule_cause(csq->class_name)) != NULL)
+		heads[1] = rc->head;
+	if (!streq(csq->instance_name, MATCH_ANY) && !streq(csq->instance_name, csq->class_name) &&
+	    (rc = find_rule_cause(csq->instance_name)) != NULL)
+		heads[2] = rc->head;
+
+	while (true) {
+		int k = -1;
+		for (int i = 0; i < 3; i++)
+			if (heads[i] != NULL && (k == -1 || heads[i]->order < heads[k]->order))
+				k = i;
+		if (k == -1)
+			break;
+		rule_t *rule = heads[k];
+		heads[k] = rule->cause_next;
+		apply_rule_delta(&rule->delta, csq);
+		if (rule->one_shot)
+			remove_rule(rule);
 	}
 }
 
@@ -228,6 +454,25 @@ bool schedule_rules(xcb_window_t win, rule_consequence_t *csq)
 {
 	if (external_rules_command[0] == '\0')
 		return false;
+	if (external_rules_persistent)
+		return request_rule_coprocess(win, csq);
+	pending_rule_t *pr = make_pending_rule(-1, win, csq);
+	if (external_rules_max_running > 0 && running_rules >= external_rules_max_running) {
+		queue_pending_rule(pr);
+		return true;
+	}
+	if (!spawn_rule_command(pr)) {
+		free(pr);
+		return false;
+	}
+	add_pending_rule(pr);
+	return true;
+}
+
+bool spawn_rule_command(pending_rule_t *pr)
+{
+	xcb_window_t win = pr->win;
+	rule_consequence_t *csq = pr->csq;
 	int fds[2];
 	if (pipe(fds) == -1)
 		return false;
@@ -235,6 +480,7 @@ bool schedule_rules(xcb_window_t win, rule_consequence_t *csq)
 	if (pid == 0) {
 		if (dpy != NULL)
 			close(xcb_get_file_descriptor(dpy));
+		restore_signals();
 		dup2(fds[1], 1);
 		close(fds[0]);
 		char wid[SMALEN];
@@ -242,74 +488,317 @@ bool schedule_rules(xcb_window_t win, rule_consequence_t *csq)
 		setsid();
 		execl(external_rules_command, external_rules_command, wid, csq->class_name, csq->instance_name, NULL);
 		err("Couldn't spawn rule command.\n");
-	} else if (pid > 0) {
-		close(fds[1]);
-		pending_rule_t *pr = make_pending_rule(fds[0], win, csq);
-		add_pending_rule(pr);
 	}
-	return (pid != -1);
+	close(fds[1]);
+	if (pid == -1) {
+		close(fds[0]);
+		return false;
+	}
+	/* a command that stalls mid-answer mustn't block the loop */
+	fcntl(fds[0], F_SETFL, O_NONBLOCK);
+	pr->fd = fds[0];
+	pr->pid = pid;
+	return true;
 }
 
-void parse_rule_consequence(int fd, rule_consequence_t *csq)
+bool start_rule_coprocess(void)
 {
-	if (fd == -1)
+	int in[2], out[2];
+	if (pipe(in) == -1)
+		return false;
+	if (pipe(out) == -1) {
+		close(in[0]);
+		close(in[1]);
+		return false;
+	}
+	pid_t pid = fork();
+	if (pid == 0) {
+		if (dpy != NULL)
+			close(xcb_get_file_descriptor(dpy));
+		restore_signals();
+		dup2(in[0], 0);
+		dup2(out[1], 1);
+		close(in[0]);
+		close(in[1]);
+		close(out[0]);
+		close(out[1]);
+		setsid();
+		execl(external_rules_command, external_rules_command, NULL);
+		err("Couldn't spawn rule command.\n");
+	}
+	close(in[0]);
+	close(out[1]);
+	if (pid == -1) {
+		close(in[1]);
+		close(out[0]);
+		return false;
+	}
+	/* the other children mustn't keep the pipes open, and a stuck command
+	 * mustn't block the window manager */
+	fcntl(in[1], F_SETFD, FD_CLOEXEC);
+	fcntl(out[0], F_SETFD, FD_CLOEXEC);
+	fcntl(in[1], F_SETFL, O_NONBLOCK);
+	rule_coprocess.pid = pid;
+	rule_coprocess.in = in[1];
+	rule_coprocess.out = out[0];
+	rule_coprocess.len = 0;
+	if (!watch_fd(out[0], EPOLLIN, &rule_coprocess.watch)) {
+		stop_rule_coprocess();
+		return false;
+	}
+	PRINTF("start rule coprocess %i\n", pid);
+	return true;
+}
+
+/* Closes the pipes of the coprocess, which is expected to exit, and manages
+ * the windows it didn't answer with their built-in consequences */
+void stop_rule_coprocess(void)
+{
+	if (rule_coprocess.in == -1)
+		return;
+	PRINTF("stop rule coprocess %i\n", rule_coprocess.pid);
+	close(rule_coprocess.in);
+	unwatch_fd(rule_coprocess.out);
+	close(rule_coprocess.out);
+	rule_coprocess.in = rule_coprocess.out = -1;
+	rule_coprocess.pid = 0;
+	pending_rule_t *pr = pending_rule_head;
+	while (pr != NULL) {
+		pending_rule_t *next = pr->next;
+		if (pr->fd == -1) {
+			manage_window(pr->win, pr->csq);
+			remove_pending_rule(pr);
+		}
+		pr = next;
+	}
+}
+
+bool request_rule_coprocess(xcb_window_t win, rule_consequence_t *csq)
+{
+	if (rule_coprocess.in == -1 && !start_rule_coprocess())
+		return false;
+	unsigned int id = ++rule_coprocess.last_id;
+	char line[MAXLEN];
+	int len = snprintf(line, sizeof(line), "%u\t%i\t%s\t%s\n", id, win, csq->class_name, csq->instance_name);
+	/* requests are shorter than PIPE_BUF, hence written whole or not at all */
+	if (write(rule_coprocess.in, line, len) != len) {
+		warn("Couldn't send the rule request of 0x%X.\n", win);
+		stop_rule_coprocess();
+		return false;
+	}
+	pending_rule_t *pr = make_pending_rule(-1, win, csq);
+	pr->id = id;
+	add_pending_rule(pr);
+	return true;
+}
+
+void read_rule_coprocess(void)
+{
+	rule_coprocess_t *rc = &rule_coprocess;
+	ssize_t nb = read(rc->out, rc->buf + rc->len, sizeof(rc->buf) - 1 - rc->len);
+	if (nb <= 0) {
+		warn("The external rules command exited.\n");
+		stop_rule_coprocess();
 		return;
+	}
+	rc->len += nb;
+	rc->buf[rc->len] = '\0';
+	char *line = rc->buf;
+	char *eol;
+	while ((eol = strchr(line, '\n')) != NULL) {
+		*eol = '\0';
+		answer_rule_request(line);
+		line = eol + 1;
+	}
+	rc->len -= line - rc->buf;
+	memmove(rc->buf, line, rc->len);
+	if (rc->len == sizeof(rc->buf) - 1) {
+		warn("Dropping an overlong rule answer.\n");
+		rc->len = 0;
+	}
+}
+
+void answer_rule_request(char *line)
+{
+	char *end;
+	unsigned long id = strtoul(line, &end, 10);
+	if (end == line)
+		return;
+	pending_rule_t *pr = pending_rule_head;
+	while (pr != NULL && (pr->fd != -1 || pr->id != id))
+		pr = pr->next;
+	/* the window might have vanished in the meantime */
+	if (pr == NULL)
+		return;
+	record_latency(&rule_stats, &pr->started);
+	parse_rule_consequence(end, pr->csq);
+	manage_window(pr->win, pr->csq);
+	remove_pending_rule(pr);
+}
+
+/* Collects the output of the rule command of the given pending rule, the
+ * window is managed once the command closes it */
+void read_pending_rule(pending_rule_t *pr)
+{
+	ssize_t nb;
 	char data[BUFSIZ];
-	int nb;
-	while ((nb = read(fd, data, sizeof(data))) > 0) {
-		int end = MIN(nb, (int) sizeof(data) - 1);
-		data[end] = '\0';
-		char *key = strtok(data, CSQ_BLK);
-		char *value = strtok(NULL, CSQ_BLK);
-		while (key != NULL && value != NULL) {
-			parse_key_value(key, value, csq);
-			key = strtok(NULL, CSQ_BLK);
-			value = strtok(NULL, CSQ_BLK);
+	while ((nb = read(pr->fd, data, sizeof(data))) != 0) {
+		if (nb == -1) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return;
+			break;
 		}
+		size_t n = MIN((size_t) nb, sizeof(pr->answer) - 1 - pr->len);
+		memcpy(pr->answer + pr->len, data, n);
+		pr->len += n;
 	}
+	pr->answer[pr->len] = '\0';
+	record_latency(&rule_stats, &pr->started);
+	parse_rule_consequence(pr->answer, pr->csq);
+	manage_window(pr->win, pr->csq);
+	remove_pending_rule(pr);
 }
 
-void parse_key_value(char *key, char *value, rule_consequence_t *csq)
+void parse_rule_consequence(char *answer, rule_consequence_t *csq)
+{
+	rule_delta_t rd = {0, 0, NULL, NULL, NULL, DIR_RIGHT, 0};
+	compile_rule_effect(answer, &rd);
+	apply_rule_delta(&rd, csq);
+	free_rule_delta(&rd);
+}
+
+/* Parses the key value pairs of the given effect, which is modified */
+void compile_rule_effect(char *effect, rule_delta_t *rd)
+{
+	char *key = strtok(effect, CSQ_BLK);
+	char *value = strtok(NULL, CSQ_BLK);
+	while (key != NULL && value != NULL) {
+		parse_key_value(key, value, rd);
+		key = strtok(NULL, CSQ_BLK);
+		value = strtok(NULL, CSQ_BLK);
+	}
+}
+
+void parse_key_value(char *key, char *value, rule_delta_t *rd)
 {
 	bool v;
 	if (streq("monitor", key)) {
-		snprintf(csq->monitor_desc, sizeof(csq->monitor_desc), "%s", value);
+		set_delta_desc(rd, CSQ_MONITOR, &rd->monitor_desc, value);
 	} else if (streq("desktop", key)) {
-		snprintf(csq->desktop_desc, sizeof(csq->desktop_desc), "%s", value);
+		set_delta_desc(rd, CSQ_DESKTOP, &rd->desktop_desc, value);
 	} else if (streq("window", key)) {
-		snprintf(csq->node_desc, sizeof(csq->node_desc), "%s", value);
+		set_delta_desc(rd, CSQ_NODE, &rd->node_desc, value);
 	} else if (streq("split_dir", key)) {
-		snprintf(csq->split_dir, sizeof(csq->split_dir), "%s", value);
+		direction_t dir;
+		if (parse_direction(value, &dir)) {
+			rd->split_dir = dir;
+			rd->mask |= CSQ_SPLIT_DIR;
+		}
 	} else if (streq("split_ratio", key)) {
 		double rat;
 		if (sscanf(value, "%lf", &rat) == 1 && rat > 0 && rat < 1) {
-			csq->split_ratio = rat;
+			rd->split_ratio = rat;
+			rd->mask |= CSQ_SPLIT_RATIO;
 		}
 	} else if (parse_bool(value, &v)) {
+		consequence_field_t field = 0;
 		if (streq("floating", key))
-			csq->floating = v;
-#define SETCSQ(name) \
+			field = CSQ_FLOATING;
+#define SETCSQ(name, flag) \
 		else if (streq(#name, key)) \
-			csq->name = v;
-		SETCSQ(pseudo_tiled)
-		SETCSQ(fullscreen)
-		SETCSQ(locked)
-		SETCSQ(sticky)
-		SETCSQ(private)
-		SETCSQ(center)
-		SETCSQ(follow)
-		SETCSQ(manage)
-		SETCSQ(focus)
-		SETCSQ(border)
+			field = flag;
+		SETCSQ(pseudo_tiled, CSQ_PSEUDO_TILED)
+		SETCSQ(fullscreen, CSQ_FULLSCREEN)
+		SETCSQ(locked, CSQ_LOCKED)
+		SETCSQ(sticky, CSQ_STICKY)
+		SETCSQ(private, CSQ_PRIVATE)
+		SETCSQ(center, CSQ_CENTER)
+		SETCSQ(follow, CSQ_FOLLOW)
+		SETCSQ(manage, CSQ_MANAGE)
+		SETCSQ(focus, CSQ_FOCUS)
+		SETCSQ(border, CSQ_BORDER)
 #undef SETCSQ
+		rd->mask |= field;
+		if (v)
+			rd->values |= field;
+		else
+			rd->values &= ~field;
 	}
 }
 
+void set_delta_desc(rule_delta_t *rd, consequence_field_t field, char **desc, char *value)
+{
+	char *s = strdup(value);
+	if (s == NULL)
+		return;
+	free(*desc);
+	*desc = s;
+	rd->mask |= field;
+}
+
+void apply_rule_delta(rule_delta_t *rd, rule_consequence_t *csq)
+{
+	if (rd->mask == 0)
+		return;
+#define APPLYCSQ(name, flag) \
+	if (rd->mask & flag) \
+		csq->name = (rd->values & flag) != 0;
+	APPLYCSQ(pseudo_tiled, CSQ_PSEUDO_TILED)
+	APPLYCSQ(floating, CSQ_FLOATING)
+	APPLYCSQ(fullscreen, CSQ_FULLSCREEN)
+	APPLYCSQ(locked, CSQ_LOCKED)
+	APPLYCSQ(sticky, CSQ_STICKY)
+	APPLYCSQ(private, CSQ_PRIVATE)
+	APPLYCSQ(center, CSQ_CENTER)
+	APPLYCSQ(follow, CSQ_FOLLOW)
+	APPLYCSQ(manage, CSQ_MANAGE)
+	APPLYCSQ(focus, CSQ_FOCUS)
+	APPLYCSQ(border, CSQ_BORDER)
+#undef APPLYCSQ
+#define APPLYDESC(name, flag) \
+	if (rd->mask & flag) { \
+		free(csq->name); \
+		csq->name = strdup(rd->name); \
+	}
+	APPLYDESC(monitor_desc, CSQ_MONITOR)
+	APPLYDESC(desktop_desc, CSQ_DESKTOP)
+	APPLYDESC(node_desc, CSQ_NODE)
+#undef APPLYDESC
+	if (rd->mask & CSQ_SPLIT_DIR) {
+		csq->presel = true;
+		csq->split_dir = rd->split_dir;
+	}
+	if (rd->mask & CSQ_SPLIT_RATIO)
+		csq->split_ratio = rd->split_ratio;
+}
+
+void free_rule_delta(rule_delta_t *rd)
+{
+	free(rd->monitor_desc);
+	free(rd->desktop_desc);
+	free(rd->node_desc);
+}
+
+void free_rule_consequence(rule_consequence_t *csq)
+{
+	if (csq == NULL)
+		return;
+	free(csq->monitor_desc);
+	free(csq->desktop_desc);
+	free(csq->node_desc);
+	free(csq);
+}
+
 void list_rules(char *pattern, FILE *rsp)
 {
-	for (rule_t *r = rule_head; r != NULL; r = r->next) {
-		if (pattern != NULL && !streq(pattern, r->cause))
-			continue;
-		fprintf(rsp, "%s => %s\n", r->cause, r->effect);
+	if (pattern != NULL) {
+		rule_cause_t *rc = find_rule_cause(pattern);
+		for (rule_t *r = (rc != NULL ? rc->head : NULL); r != NULL; r = r->cause_next)
+			fprintf(rsp, "%s => %s\n", r->cause, r->effect);
+		return;
 	}
+	for (rule_t *r = rule_head; r != NULL; r = r->next)
+		fprintf(rsp, "%s => %s\n", r->cause, r->effect);
 }
@@ -28,19 +28,42 @@
 #define MATCH_ANY  "*"
 #define CSQ_BLK    " =,\n"
 
+#define RULE_TABLE_MIN_SIZE  32
+
 rule_t *make_rule(void);
 void add_rule(rule_t *r);
 void remove_rule(rule_t *r);
+unsigned int rule_hash(const char *cause);
+void rule_table_grow(void);
+rule_cause_t *find_rule_cause(const char *cause);
+rule_cause_t *get_rule_cause(const char *cause);
+void release_rule_cause(rule_cause_t *rc, const char *cause);
 void remove_rule_by_cause(char *cause);
 bool remove_rule_by_index(int idx);
 rule_consequence_t *make_rule_conquence(void);
 pending_rule_t *make_pending_rule(int fd, xcb_window_t win, rule_consequence_t *csq);
 void add_pending_rule(pending_rule_t *pr);
 void remove_pending_rule(pending_rule_t *pr);
-void apply_rules(xcb_window_t win, rule_consequence_t *csq);
+void queue_pending_rule(pending_rule_t *pr);
+void run_queued_rules(void);
+void expire_pending_rules(void);
+int next_rule_timeout(void);
+void apply_rules(xcb_window_t win, rule_consequence_t *csq, prefetch_t *pf);
 bool schedule_rules(xcb_window_t win, rule_consequence_t *csq);
-void parse_rule_consequence(int fd, rule_consequence_t *csq);
-void parse_key_value(char *key, char *value, rule_consequence_t *csq);
+bool spawn_rule_command(pending_rule_t *pr);
+bool start_rule_coprocess(void);
+void stop_rule_coprocess(void);
+bool request_rule_coprocess(xcb_window_t win, rule_consequence_t *csq);
+void read_rule_coprocess(void);
+void answer_rule_request(char *line);
+void read_pending_rule(pending_rule_t *pr);
+void parse_rule_consequence(char *answer, rule_consequence_t *csq);
+void compile_rule_effect(char *effect, rule_delta_t *rd);
+void parse_key_value(char *key, char *value, rule_delta_t *rd);
+void set_delta_desc(rule_delta_t *rd, consequence_field_t field, char **desc, char *value);
+void apply_rule_delta(rule_delta_t *rd, rule_consequence_t *csq);
+void free_rule_delta(rule_delta_t *rd);
+void free_rule_consequence(rule_consequence_t *csq);
 void list_rules(char *pattern, FILE *rsp);
 
 #endif
@@ -22,8 +22,14 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include "bspwm.h"
+#include "common.h"
+#include "messages.h"
 #include "settings.h"
 
 void run_config(void)
@@ -31,12 +37,49 @@ void run_config(void)
 	if (fork() == 0) {
 		if (dpy != NULL)
 			close(xcb_get_file_descriptor(dpy));
+		restore_signals();
 		setsid();
 		execl(config_path, config_path, NULL);
 		err("Couldn't execute the configuration file.\n");
 	}
 }
 
+/* Runs the commands of the declarations file, one per line, in process:
+ * unlike the configuration file, it is read before any window is managed
+ * and doesn't cost a connection per command. */
+void load_declarations(void)
+{
+	FILE *decl = fopen(declarations_path, "r");
+	if (decl == NULL) {
+		if (errno != ENOENT)
+			warn("Couldn't open the declarations file.\n");
+		return;
+	}
+	char *line = NULL, *words[MAXLEN];
+	size_t cap = 0;
+	unsigned int num = 0;
+	while (getline(&line, &cap, decl) != -1) {
+		num++;
+		int n = split_words(line, words, LENGTH(words));
+		if (n == 0)
+			continue;
+		int ret = MSG_SYNTAX;
+		if (n > 0 && valid_declaration(words[0]))
+			ret = process_message(words, n, stdout);
+		if (ret != MSG_SUCCESS)
+			warn("%s:%u: invalid declaration.\n", declarations_path, num);
+	}
+	free(line);
+	fclose(decl);
+}
+
+/* Only the commands that describe the initial state are accepted */
+bool valid_declaration(char *cmd)
+{
+	return (streq("config", cmd) || streq("monitor", cmd) ||
+	        streq("desktop", cmd) || streq("rule", cmd));
+}
+
 void load_settings(void)
 {
 	snprintf(external_rules_command, sizeof(external_rules_command), "%s", EXTERNAL_RULES_COMMAND);
@@ -61,6 +104,9 @@ void load_settings(void)
 	window_gap = WINDOW_GAP;
 	border_width = BORDER_WIDTH;
 	initial_polarity = FIRST_CHILD;
+	subscriber_overflow = SUBSCRIBER_OVERFLOW;
+	external_rules_timeout = EXTERNAL_RULES_TIMEOUT;
+	external_rules_max_running = EXTERNAL_RULES_MAX_RUNNING;
 
 	borderless_monocle = BORDERLESS_MONOCLE;
 	gapless_monocle = GAPLESS_MONOCLE;
@@ -73,6 +119,7 @@ void load_settings(void)
 	auto_cancel = AUTO_CANCEL;
 	history_aware_focus = HISTORY_AWARE_FOCUS;
 	ignore_ewmh_focus = IGNORE_EWMH_FOCUS;
+	external_rules_persistent = EXTERNAL_RULES_PERSISTENT;
 	center_pseudo_tiled = CENTER_PSEUDO_TILED;
 	remove_disabled_monitors = REMOVE_DISABLED_MONITORS;
 	remove_unplugged_monitors = REMOVE_UNPLUGGED_MONITORS;
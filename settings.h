@@ -29,6 +29,7 @@
 
 #define WM_NAME                 "bspwm"
 #define CONFIG_NAME             WM_NAME "rc"
+#define DECLARATIONS_NAME       WM_NAME ".conf"
 #define CONFIG_HOME_ENV         "XDG_CONFIG_HOME"
 #define EXTERNAL_RULES_COMMAND  ""
 #define STATUS_PREFIX           "W"
@@ -52,6 +53,11 @@
 #define WINDOW_GAP     6
 #define BORDER_WIDTH   1
 
+#define SUBSCRIBER_OVERFLOW  OVERFLOW_COALESCE
+
+#define EXTERNAL_RULES_TIMEOUT      1000
+#define EXTERNAL_RULES_MAX_RUNNING  8
+
 #define HISTORY_AWARE_FOCUS         false
 #define FOCUS_BY_DISTANCE           false
 #define BORDERLESS_MONOCLE          false
@@ -64,6 +70,7 @@
 #define AUTO_CANCEL                 false
 #define APPLY_FLOATING_ATOM         false
 #define IGNORE_EWMH_FOCUS           false
+#define EXTERNAL_RULES_PERSISTENT   false
 #define CENTER_PSEUDO_TILED         true
 #define REMOVE_DISABLED_MONITORS    false
 #define REMOVE_UNPLUGGED_MONITORS   false
@@ -91,6 +98,9 @@ double split_ratio;
 int window_gap;
 unsigned int border_width;
 child_polarity_t initial_polarity;
+overflow_policy_t subscriber_overflow;
+unsigned int external_rules_timeout;
+unsigned int external_rules_max_running;
 
 bool borderless_monocle;
 bool gapless_monocle;
@@ -104,12 +114,15 @@ bool auto_cancel;
 bool history_aware_focus;
 bool focus_by_distance;
 bool ignore_ewmh_focus;
+bool external_rules_persistent;
 bool center_pseudo_tiled;
 bool remove_disabled_monitors;
 bool remove_unplugged_monitors;
 bool merge_overlapping_monitors;
 
 void run_config(void);
+void load_declarations(void);
+bool valid_declaration(char *cmd);
 void load_settings(void);
 
 #endif
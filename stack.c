@@ -27,55 +27,94 @@
 #include "window.h"
 #include "stack.h"
 
+stack_layer_t stack_layer(client_t *c)
+{
+	if (c->fullscreen)
+		return LAYER_FULLSCREEN;
+	else if (c->floating)
+		return LAYER_FLOATING;
+	else
+		return LAYER_TILED;
+}
+
 stacking_list_t *make_stack(node_t *n)
 {
 	stacking_list_t *s = malloc(sizeof(stacking_list_t));
 	s->node = n;
+	s->layer = stack_layer(n->client);
+	s->dirty = false;
+	s->raise = false;
 	s->prev = s->next = NULL;
+	n->stack_entry = s;
 	return s;
 }
 
-void stack_insert_after(stacking_list_t *a, node_t *n)
+/* Links the entry of the given node between the two given neighbours of the
+ * given layer, reusing the entry the node might already have */
+void stack_link(node_t *n, stack_layer_t l, stacking_list_t *a, stacking_list_t *b)
 {
-	stacking_list_t *s = make_stack(n);
-	if (a == NULL) {
-		stack_head = stack_tail = s;
-	} else {
-		if (a->node == n)
-			return;
-		remove_stack_node(n);
-		stacking_list_t *b = a->next;
-		if (b != NULL)
-			b->prev = s;
-		s->next = b;
-		s->prev = a;
+	stacking_list_t *s = n->stack_entry;
+	if (s == NULL)
+		s = make_stack(n);
+	s->layer = l;
+	s->prev = a;
+	s->next = b;
+	if (a != NULL)
 		a->next = s;
-		if (stack_tail == a)
-			stack_tail = s;
-	}
+	else
+		stack_head[l] = s;
+	if (b != NULL)
+		b->prev = s;
+	else
+		stack_tail[l] = s;
+	s->raise = false;
+	invalidate_stack(s);
 }
 
-void stack_insert_before(stacking_list_t *a, node_t *n)
+/* Schedules the restacking of the given entry for the commit phase */
+void invalidate_stack(stacking_list_t *s)
 {
-	stacking_list_t *s = make_stack(n);
-	if (a == NULL) {
-		stack_head = stack_tail = s;
-	} else {
-		if (a->node == n)
+	if (s->dirty)
+		return;
+	if (dirty_stack_len == dirty_stack_cap) {
+		unsigned int cap = (dirty_stack_cap == 0 ? 16 : 2 * dirty_stack_cap);
+		stacking_list_t **entries = realloc(dirty_stack, cap * sizeof(stacking_list_t *));
+		if (entries == NULL) {
+			warn("Couldn't grow the dirty stack list.\n");
 			return;
-		remove_stack_node(n);
-		stacking_list_t *b = a->prev;
-		if (b != NULL)
-			b->next = s;
-		s->prev = b;
-		s->next = a;
-		a->prev = s;
-		if (stack_head == a)
-			stack_head = s;
+		}
+		dirty_stack = entries;
+		dirty_stack_cap = cap;
 	}
+	s->dirty = true;
+	dirty_stack[dirty_stack_len++] = s;
 }
 
-void remove_stack(stacking_list_t *s)
+/* Inserts the given node right after the given entry, or at the bottom of
+ * the layer of the node if the entry is NULL */
+void stack_insert_after(stacking_list_t *a, node_t *n)
+{
+	stacking_list_t *s = n->stack_entry;
+	if (s != NULL && (s == a || (a != NULL ? a->next : stack_head[stack_layer(n->client)]) == s))
+		return;
+	stack_layer_t l = (a != NULL ? a->layer : stack_layer(n->client));
+	stack_unlink(s);
+	stack_link(n, l, a, (a != NULL ? a->next : stack_head[l]));
+}
+
+/* Inserts the given node right before the given entry, or at the top of the
+ * layer of the node if the entry is NULL */
+void stack_insert_before(stacking_list_t *a, node_t *n)
+{
+	stacking_list_t *s = n->stack_entry;
+	if (s != NULL && (s == a || (a != NULL ? a->prev : stack_tail[stack_layer(n->client)]) == s))
+		return;
+	stack_layer_t l = (a != NULL ? a->layer : stack_layer(n->client));
+	stack_unlink(s);
+	stack_link(n, l, (a != NULL ? a->prev : stack_tail[l]), a);
+}
+
+void stack_unlink(stacking_list_t *s)
 {
 	if (s == NULL)
 		return;
@@ -85,80 +124,123 @@ void remove_stack(stacking_list_t *s)
 		a->next = b;
 	if (b != NULL)
 		b->prev = a;
-	if (s == stack_head)
-		stack_head = b;
-	if (s == stack_tail)
-		stack_tail = a;
+	if (s == stack_head[s->layer])
+		stack_head[s->layer] = b;
+	if (s == stack_tail[s->layer])
+		stack_tail[s->layer] = a;
+	s->prev = s->next = NULL;
+}
+
+void remove_stack(stacking_list_t *s)
+{
+	if (s == NULL)
+		return;
+	if (s->dirty)
+		for (unsigned int i = 0; i < dirty_stack_len; i++)
+			if (dirty_stack[i] == s) {
+				dirty_stack[i] = dirty_stack[--dirty_stack_len];
+				break;
+			}
+	stack_unlink(s);
+	s->node->stack_entry = NULL;
 	free(s);
 }
 
 void remove_stack_node(node_t *n)
 {
-	for (stacking_list_t *s = stack_head; s != NULL; s = s->next)
-		if (s->node == n) {
-			remove_stack(s);
-			return;
-		}
+	remove_stack(n->stack_entry);
+}
+
+/* Returns the entry right below the given one, across layers */
+stacking_list_t *stack_prev(stacking_list_t *s)
+{
+	if (s->prev != NULL)
+		return s->prev;
+	for (int l = s->layer - 1; l >= 0; l--)
+		if (stack_tail[l] != NULL)
+			return stack_tail[l];
+	return NULL;
+}
+
+/* Returns the entry right above the given one, across layers */
+stacking_list_t *stack_next(stacking_list_t *s)
+{
+	if (s->next != NULL)
+		return s->next;
+	for (int l = s->layer + 1; l < LAYER_LENGTH; l++)
+		if (stack_head[l] != NULL)
+			return stack_head[l];
+	return NULL;
+}
+
+stacking_list_t *stack_bottom(void)
+{
+	for (int l = 0; l < LAYER_LENGTH; l++)
+		if (stack_head[l] != NULL)
+			return stack_head[l];
+	return NULL;
 }
 
+/* Moves the given node to the top or the bottom of the layer matching the
+ * state of its client: tiled windows stay below floating ones, which stay
+ * below fullscreen ones */
 void stack(node_t *n, stack_flavor_t f)
 {
 	PRINTF("stack %X\n", n->client->window);
 
-	if (stack_head == NULL) {
-		stack_insert_after(NULL, n);
-	} else if (n->client->fullscreen) {
-		if (f == STACK_ABOVE) {
-			stack_insert_after(stack_tail, n);
-			window_raise(n->client->window);
-		}
-	} else {
-		if (f == STACK_ABOVE && n->client->floating && !auto_raise)
+	stacking_list_t *s = n->stack_entry;
+	stack_layer_t l = stack_layer(n->client);
+	bool same_layer = (s != NULL && s->layer == l);
+
+	if (f == STACK_ABOVE) {
+		if (same_layer && l == LAYER_FLOATING && !auto_raise)
 			return;
-		stacking_list_t *latest_tiled = NULL;
-		stacking_list_t *oldest_floating = NULL;
-		stacking_list_t *oldest_fullscreen = NULL;
-		for (stacking_list_t *s = (f == STACK_ABOVE ? stack_tail : stack_head); s != NULL; s = (f == STACK_ABOVE ? s->prev : s->next)) {
-			if (s->node != n) {
-				if (s->node->client->fullscreen) {
-					if (oldest_fullscreen == NULL)
-						oldest_fullscreen = s;
-					continue;
-				}
-				if (s->node->client->floating == n->client->floating) {
-					if (f == STACK_ABOVE) {
-						stack_insert_after(s, n);
-						window_above(n->client->window, s->node->client->window);
-					} else {
-						stack_insert_before(s, n);
-						window_below(n->client->window, s->node->client->window);
-					}
-					return;
-				} else if ((f != STACK_ABOVE || latest_tiled == NULL) && !s->node->client->floating) {
-					latest_tiled = s;
-				} else if ((f == STACK_ABOVE || oldest_floating == NULL) && s->node->client->floating) {
-					oldest_floating = s;
-				}
-			}
+		stack_insert_after(stack_tail[l], n);
+		/* fullscreen windows also go above the unmanaged ones */
+		if (l == LAYER_FULLSCREEN) {
+			invalidate_stack(n->stack_entry);
+			n->stack_entry->raise = true;
 		}
-		if (latest_tiled == NULL && oldest_floating == NULL && oldest_fullscreen == NULL)
+	} else {
+		if (same_layer && l == LAYER_FULLSCREEN)
 			return;
-		if (n->client->floating) {
-			if (latest_tiled != NULL) {
-				window_above(n->client->window, latest_tiled->node->client->window);
-				stack_insert_after(latest_tiled, n);
-			} else if (oldest_fullscreen != NULL) {
-				window_below(n->client->window, oldest_fullscreen->node->client->window);
-				stack_insert_before(oldest_fullscreen, n);
+		stack_insert_before(stack_head[l], n);
+	}
+}
+
+/* Restacks the entries moved since the last commit so that the server order
+ * matches the stacking list. Only the dirty entries are visited, by runs of
+ * adjacent ones: a run is restacked upwards from its lower neighbour, or
+ * downwards from its upper neighbour when it starts at the bottom, so that
+ * every reference window is already in place. */
+void commit_stack(void)
+{
+	for (unsigned int i = 0; i < dirty_stack_len; i++) {
+		stacking_list_t *s = dirty_stack[i];
+		if (!s->dirty)
+			continue;
+		stacking_list_t *a, *b;
+		while ((a = stack_prev(s)) != NULL && a->dirty)
+			s = a;
+		if (a != NULL) {
+			for (; s != NULL && s->dirty; s = stack_next(s)) {
+				if (s->raise)
+					window_raise(s->node->client->window);
+				else
+					window_above(s->node->client->window, stack_prev(s)->node->client->window);
+				s->dirty = s->raise = false;
 			}
 		} else {
-			if (oldest_floating != NULL) {
-				window_below(n->client->window, oldest_floating->node->client->window);
-				stack_insert_before(oldest_floating, n);
-			} else if (oldest_fullscreen != NULL) {
-				window_below(n->client->window, oldest_fullscreen->node->client->window);
-				stack_insert_before(oldest_fullscreen, n);
+			while ((b = stack_next(s)) != NULL && b->dirty)
+				s = b;
+			for (; s != NULL && s->dirty; s = stack_prev(s)) {
+				if ((b = stack_next(s)) != NULL)
+					window_below(s->node->client->window, b->node->client->window);
+				else if (s->raise)
+					window_raise(s->node->client->window);
+				s->dirty = s->raise = false;
 			}
 		}
 	}
+	dirty_stack_len = 0;
 }
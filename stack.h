@@ -30,11 +30,19 @@ typedef enum {
 	STACK_BELOW
 } stack_flavor_t;
 
+stack_layer_t stack_layer(client_t *c);
 stacking_list_t *make_stack(node_t *n);
+void stack_link(node_t *n, stack_layer_t l, stacking_list_t *a, stacking_list_t *b);
 void stack_insert_after(stacking_list_t *a, node_t *n);
 void stack_insert_before(stacking_list_t *a, node_t *n);
+void stack_unlink(stacking_list_t *s);
+void invalidate_stack(stacking_list_t *s);
 void remove_stack(stacking_list_t *s);
 void remove_stack_node(node_t *n);
+stacking_list_t *stack_prev(stacking_list_t *s);
+stacking_list_t *stack_next(stacking_list_t *s);
+stacking_list_t *stack_bottom(void);
 void stack(node_t *n, stack_flavor_t f);
+void commit_stack(void);
 
 #endif
@@ -0,0 +1,135 @@
+/* Copyright (c) 2012, Bastien Dejean
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <xcb/xcb_event.h>
+#include "bspwm.h"
+#include "stats.h"
+
+static char *command_names[STATS_COMMANDS] = {
+	"window", "desktop", "monitor", "query", "restore",
+	"control", "rule", "pointer", "config", "quit"
+};
+
+void stats_clock(struct timespec *ts)
+{
+	clock_gettime(CLOCK_MONOTONIC, ts);
+}
+
+/* Microseconds elapsed since the given stamp. */
+unsigned long stats_elapsed(struct timespec *start)
+{
+	struct timespec now;
+	stats_clock(&now);
+	long sec = now.tv_sec - start->tv_sec;
+	long nsec = now.tv_nsec - start->tv_nsec;
+	return (sec * 1000000000L + nsec) / 1000;
+}
+
+/* Add the time elapsed since the given stamp, in microseconds, to the
+ * histogram. Bucket 0 counts durations below 1 µs, bucket i those in
+ * [2^(i-1), 2^i) µs; the last bucket absorbs everything above. */
+void record_latency(histogram_t *h, struct timespec *start)
+{
+	unsigned long us = stats_elapsed(start);
+	unsigned int i = 0;
+	while (i < STATS_BUCKETS - 1 && (us >> i) > 0)
+		i++;
+	h->count++;
+	h->total += us;
+	if (us > h->max)
+		h->max = us;
+	h->buckets[i]++;
+}
+
+void record_event(uint8_t resp_type, struct timespec *start)
+{
+	if (resp_type < STATS_EVENT_TYPES)
+		record_latency(&event_stats[resp_type], start);
+}
+
+void record_command(char *name, struct timespec *start)
+{
+	for (unsigned int i = 0; i < STATS_COMMANDS; i++)
+		if (streq(command_names[i], name)) {
+			record_latency(&command_stats[i], start);
+			return;
+		}
+}
+
+/* The X request counter is the distance between the sequence numbers of two
+ * no-op requests, minus the no-ops sent by the queries in between. */
+void reset_stats(void)
+{
+	memset(event_stats, 0, sizeof(event_stats));
+	memset(command_stats, 0, sizeof(command_stats));
+	memset(&rule_stats, 0, sizeof(rule_stats));
+	arrange_count = subscriber_bytes = suppressed_requests = rule_timeouts = 0;
+	request_base = xcb_no_operation(dpy).sequence;
+	request_probes = 0;
+	stats_clock(&stats_since);
+}
+
+void print_histogram(char *kind, const char *name, histogram_t *h, FILE *rsp)
+{
+	unsigned int last = STATS_BUCKETS;
+	while (last > 0 && h->buckets[last - 1] == 0)
+		last--;
+	fprintf(rsp, "%s %s count %lu total %lu max %lu buckets", kind, name, h->count, h->total, h->max);
+	for (unsigned int i = 0; i < last; i++)
+		fprintf(rsp, " %lu", h->buckets[i]);
+	fprintf(rsp, "\n");
+}
+
+void print_stats(FILE *rsp)
+{
+	struct timespec now;
+	stats_clock(&now);
+	unsigned int requests = xcb_no_operation(dpy).sequence - request_base - ++request_probes;
+	for (unsigned int i = 0; i < STATS_EVENT_TYPES; i++) {
+		histogram_t *h = &event_stats[i];
+		if (h->count == 0)
+			continue;
+		char num[SMALEN];
+		const char *name = xcb_event_get_label(i);
+		if (name == NULL) {
+			snprintf(num, sizeof(num), "%u", i);
+			name = num;
+		}
+		print_histogram("event", name, h, rsp);
+	}
+	for (unsigned int i = 0; i < STATS_COMMANDS; i++)
+		if (command_stats[i].count > 0)
+			print_histogram("command", command_names[i], &command_stats[i], rsp);
+	if (rule_stats.count > 0)
+		print_histogram("rule", "external", &rule_stats, rsp);
+	fprintf(rsp, "arrange %lu\n", arrange_count);
+	fprintf(rsp, "requests %u\n", requests);
+	fprintf(rsp, "suppressed %lu\n", suppressed_requests);
+	fprintf(rsp, "subscriber_bytes %lu\n", subscriber_bytes);
+	fprintf(rsp, "rule_timeouts %lu\n", rule_timeouts);
+	fprintf(rsp, "seconds %li\n", (long) (now.tv_sec - stats_since.tv_sec));
+}
@@ -0,0 +1,61 @@
+/* Copyright (c) 2012, Bastien Dejean
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BSPWM_STATS_H
+#define BSPWM_STATS_H
+
+#include <time.h>
+
+#define STATS_BUCKETS     24
+#define STATS_EVENT_TYPES 128
+#define STATS_COMMANDS    10
+
+typedef struct {
+	unsigned long count;
+	unsigned long total;
+	unsigned long max;
+	unsigned long buckets[STATS_BUCKETS];
+} histogram_t;
+
+histogram_t event_stats[STATS_EVENT_TYPES];
+histogram_t command_stats[STATS_COMMANDS];
+unsigned long arrange_count;
+unsigned long subscriber_bytes;
+unsigned long suppressed_requests;
+histogram_t rule_stats;
+unsigned long rule_timeouts;
+unsigned int request_base;
+unsigned int request_probes;
+struct timespec stats_since;
+
+void stats_clock(struct timespec *ts);
+unsigned long stats_elapsed(struct timespec *start);
+void record_latency(histogram_t *h, struct timespec *start);
+void record_event(uint8_t resp_type, struct timespec *start);
+void record_command(char *name, struct timespec *start);
+void reset_stats(void);
+void print_histogram(char *kind, const char *name, histogram_t *h, FILE *rsp);
+void print_stats(FILE *rsp);
+
+#endif
@@ -23,20 +23,35 @@
  */
 
 #include <stdlib.h>
+#include <errno.h>
 #include <unistd.h>
+#include <string.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
 #include <stdarg.h>
 #include "bspwm.h"
 #include "tree.h"
 #include "settings.h"
+#include "stats.h"
 #include "subscribe.h"
 
 subscriber_list_t *make_subscriber_list(FILE *stream, int field)
 {
 	subscriber_list_t *sb = malloc(sizeof(subscriber_list_t));
 	sb->prev = sb->next = NULL;
+	sb->fd = fileno(stream);
 	sb->stream = stream;
 	sb->field = field;
+	sb->head = sb->count = 0;
+	sb->offset = 0;
+	sb->pending_report = sb->blocked = false;
+	sb->last_report = NULL;
+	sb->last_report_len = 0;
+	sb->sent = sb->dropped = sb->coalesced = sb->duplicates = 0;
+	sb->watch = (watch_t) {WATCH_SUBSCRIBER, sb};
+	fcntl(sb->fd, F_SETFL, fcntl(sb->fd, F_GETFL) | O_NONBLOCK);
 	return sb;
 }
 
@@ -54,12 +69,17 @@ void remove_subscriber(subscriber_list_t *sb)
 		subscribe_head = b;
 	if (sb == subscribe_tail)
 		subscribe_tail = a;
+	while (sb->count > 0)
+		pop_status(sb);
+	free(sb->last_report);
+	unwatch_fd(sb->fd);
 	fclose(sb->stream);
 	free(sb);
 }
 
 void add_subscriber(FILE *stream, int field)
 {
+	fflush(stream);
 	subscriber_list_t *sb = make_subscriber_list(stream, field);
 	if (subscribe_head == NULL) {
 		subscribe_head = subscribe_tail = sb;
@@ -68,21 +88,158 @@ void add_subscriber(FILE *stream, int field)
 		sb->prev = subscribe_tail;
 		subscribe_tail = sb;
 	}
+	watch_fd(sb->fd, EPOLLIN, &sb->watch);
 	if (sb->field & SBSC_MASK_REPORT) {
-		print_report(sb->stream);
+		size_t len;
+		char *report = make_report(&len);
+		if (report != NULL) {
+			remember_report(sb, report, len);
+			queue_status(sb, report, len, true);
+		}
+		free(report);
 	}
 }
 
+void drain_subscriber(subscriber_list_t *sb)
+{
+	char data[BUFSIZ];
+	ssize_t nb;
+	while ((nb = recv(sb->fd, data, sizeof(data), MSG_DONTWAIT)) > 0)
+		;
+	if (nb == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+		remove_subscriber(sb);
+}
+
+/* Write as much of the queue as the socket accepts. Returns false if the
+ * subscriber was removed. */
+bool flush_subscriber(subscriber_list_t *sb)
+{
+	while (sb->count > 0 || sb->pending_report) {
+		if (sb->count == 0) {
+			size_t len;
+			char *report = make_report(&len);
+			sb->pending_report = false;
+			if (report == NULL)
+				break;
+			remember_report(sb, report, len);
+			push_status(sb, report, len, true);
+			free(report);
+		}
+		status_message_t *msg = &sb->queue[sb->head];
+		ssize_t nb = send(sb->fd, msg->data + sb->offset, msg->len - sb->offset, MSG_DONTWAIT);
+		if (nb == -1) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				if (!sb->blocked) {
+					sb->blocked = true;
+					rewatch_fd(sb->fd, EPOLLIN | EPOLLOUT, &sb->watch);
+				}
+				return true;
+			}
+			remove_subscriber(sb);
+			return false;
+		}
+		sb->sent += nb;
+		subscriber_bytes += nb;
+		sb->offset += nb;
+		if (sb->offset == msg->len)
+			pop_status(sb);
+	}
+	if (sb->blocked) {
+		sb->blocked = false;
+		rewatch_fd(sb->fd, EPOLLIN, &sb->watch);
+	}
+	return true;
+}
+
+/* Queue the given message and try to send it right away. Returns false if the
+ * subscriber was removed. */
+bool queue_status(subscriber_list_t *sb, char *data, size_t len, bool report)
+{
+	if (report && subscriber_overflow == OVERFLOW_COALESCE) {
+		/* a report still waiting in the queue is updated where it stands,
+		 * unless the head one is being sent already */
+		for (unsigned int i = sb->count; i > (sb->offset > 0 ? 1 : 0); i--) {
+			status_message_t *msg = &sb->queue[(sb->head + i - 1) % SUBSCRIBER_QUEUE_LEN];
+			if (!msg->report)
+				continue;
+			char *copy = malloc(len);
+			if (copy == NULL)
+				break;
+			memcpy(copy, data, len);
+			free(msg->data);
+			msg->data = copy;
+			msg->len = len;
+			sb->coalesced++;
+			return true;
+		}
+		if (sb->count == SUBSCRIBER_QUEUE_LEN) {
+			if (sb->pending_report)
+				sb->coalesced++;
+			sb->pending_report = true;
+			return true;
+		}
+	}
+	if (sb->count == SUBSCRIBER_QUEUE_LEN) {
+		if (subscriber_overflow == OVERFLOW_DISCONNECT) {
+			warn("Dropping a lagging subscriber.\n");
+			subscribe_overflows++;
+			remove_subscriber(sb);
+			return false;
+		}
+		/* the oldest message might be partially sent */
+		if (sb->offset > 0) {
+			unsigned int next = (sb->head + 1) % SUBSCRIBER_QUEUE_LEN;
+			free(sb->queue[next].data);
+			sb->queue[next] = sb->queue[sb->head];
+			sb->head = next;
+			sb->count--;
+		} else {
+			pop_status(sb);
+		}
+		sb->dropped++;
+	}
+	push_status(sb, data, len, report);
+	return flush_subscriber(sb);
+}
+
+void push_status(subscriber_list_t *sb, char *data, size_t len, bool report)
+{
+	status_message_t *msg = &sb->queue[(sb->head + sb->count) % SUBSCRIBER_QUEUE_LEN];
+	msg->data = malloc(len);
+	msg->len = len;
+	msg->report = report;
+	memcpy(msg->data, data, len);
+	sb->count++;
+}
+
+void pop_status(subscriber_list_t *sb)
+{
+	free(sb->queue[sb->head].data);
+	sb->head = (sb->head + 1) % SUBSCRIBER_QUEUE_LEN;
+	sb->count--;
+	sb->offset = 0;
+}
+
+char *make_report(size_t *len)
+{
+	char *report = NULL;
+	FILE *stream = open_memstream(&report, len);
+	if (stream == NULL)
+		return NULL;
+	print_report(stream);
+	fclose(stream);
+	return report;
+}
+
 int print_report(FILE *stream)
 {
 	fprintf(stream, "%s", status_prefix);
-	bool urgent = false;
 	for (monitor_t *m = mon_head; m != NULL; m = m->next) {
 		fprintf(stream, "%c%s:", (mon == m ? 'M' : 'm'), m->name);
-		for (desktop_t *d = m->desk_head; d != NULL; d = d->next, urgent = false) {
-			for (node_t *n = first_extrema(d->root); n != NULL && !urgent; n = next_leaf(n, d->root))
-				urgent |= n->client->urgent;
-			char c = (urgent ? 'u' : (d->root == NULL ? 'f' : 'o'));
+		for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
+			char c = (d->urgent_count > 0 ? 'u' : (d->client_count == 0 ? 'f' : 'o'));
 			if (m->desk == d)
 				c = toupper(c);
 			fprintf(stream, "%c%s:", c, d->name);
@@ -97,25 +254,80 @@ int print_report(FILE *stream)
 void put_status(subscriber_mask_t mask, ...)
 {
 	subscriber_list_t *sb = subscribe_head;
-	int ret;
+	while (sb != NULL && !(sb->field & mask))
+		sb = sb->next;
+	if (sb == NULL)
+		return;
+
+	/* reports are sent once per iteration of the main loop */
+	if (mask == SBSC_MASK_REPORT) {
+		report_dirty = true;
+		return;
+	}
+
+	char *msg = NULL;
+	size_t len = 0;
+	FILE *stream = open_memstream(&msg, &len);
+	if (stream != NULL) {
+		char *fmt;
+		va_list args;
+		va_start(args, mask);
+		fmt = va_arg(args, char *);
+		vfprintf(stream, fmt, args);
+		va_end(args);
+		fclose(stream);
+	}
+	if (msg == NULL)
+		return;
+
+	while (sb != NULL) {
+		subscriber_list_t *next = sb->next;
+		if (sb->field & mask)
+			queue_status(sb, msg, len, false);
+		sb = next;
+	}
+	free(msg);
+}
+
+/* Sends the report requested since the last call to the subscribers whose
+ * previous report differs */
+void flush_report(void)
+{
+	if (!report_dirty)
+		return;
+	report_dirty = false;
+
+	size_t len;
+	char *report = make_report(&len);
+	if (report == NULL)
+		return;
+
+	subscriber_list_t *sb = subscribe_head;
 	while (sb != NULL) {
 		subscriber_list_t *next = sb->next;
-		if (sb->field & mask) {
-			if (mask == SBSC_MASK_REPORT) {
-				ret = print_report(sb->stream);
+		if (sb->field & SBSC_MASK_REPORT) {
+			if (sb->last_report != NULL && sb->last_report_len == len &&
+			    memcmp(sb->last_report, report, len) == 0) {
+				sb->duplicates++;
 			} else {
-				char *fmt;
-				va_list args;
-				va_start(args, mask);
-				fmt = va_arg(args, char *);
-				vfprintf(sb->stream, fmt, args);
-				va_end(args);
-				ret = fflush(sb->stream);
-			}
-			if (ret != 0) {
-				remove_subscriber(sb);
+				remember_report(sb, report, len);
+				queue_status(sb, report, len, true);
 			}
 		}
 		sb = next;
 	}
+	free(report);
+}
+
+void remember_report(subscriber_list_t *sb, char *report, size_t len)
+{
+	char *copy = realloc(sb->last_report, len);
+	if (copy == NULL) {
+		free(sb->last_report);
+		sb->last_report = NULL;
+		return;
+	}
+	memcpy(copy, report, len);
+	sb->last_report = copy;
+	sb->last_report_len = len;
 }
@@ -57,7 +57,15 @@ typedef enum {
 subscriber_list_t *make_subscriber_list(FILE *stream, int field);
 void remove_subscriber(subscriber_list_t *sb);
 void add_subscriber(FILE *stream, int field);
+void drain_subscriber(subscriber_list_t *sb);
+bool flush_subscriber(subscriber_list_t *sb);
+bool queue_status(subscriber_list_t *sb, char *data, size_t len, bool report);
+void push_status(subscriber_list_t *sb, char *data, size_t len, bool report);
+void pop_status(subscriber_list_t *sb);
+char *make_report(size_t *len);
 int print_report(FILE *stream);
 void put_status(subscriber_mask_t mask, ...);
+void flush_report(void);
+void remember_report(subscriber_list_t *sb, char *report, size_t len);
 
 #endif
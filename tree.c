@@ -33,21 +33,44 @@
 #include "subscribe.h"
 #include "settings.h"
 #include "stack.h"
+#include "stats.h"
 #include "window.h"
+#include "wintable.h"
 #include "tree.h"
 
+/* Marks the given desktop for the next commit: however many changes happen
+ * in between, its layout is computed once, on the monitor it's on by then */
 void arrange(monitor_t *m, desktop_t *d)
 {
+	(void) m;
 	if (d->root == NULL)
 		return;
+	d->dirty = true;
+	d->laid_out = false;
+}
+
+/* Computes the pending arrangement of the given desktop right away, for the
+ * callers that read its geometry before the commit */
+void update_layout(monitor_t *m, desktop_t *d)
+{
+	if (!d->dirty || d->laid_out || d->root == NULL)
+		return;
 
 	PRINTF("arrange %s %s\n", m->name, d->name);
 
+	d->laid_out = true;
+	arrange_count++;
+
 	layout_t set_layout = d->layout;
 	if (leaf_monocle && tiled_count(d) == 1) {
 		d->layout = LAYOUT_MONOCLE;
 	}
 
+	if (d->layout != d->arranged_layout) {
+		invalidate_tree(d->root);
+		d->arranged_layout = d->layout;
+	}
+
 	xcb_rectangle_t rect = m->rectangle;
 	int wg = (gapless_monocle && d->layout == LAYOUT_MONOCLE ? 0 : d->window_gap);
 	rect.x += m->left_padding + d->left_padding + wg;
@@ -59,12 +82,83 @@ void arrange(monitor_t *m, desktop_t *d)
 	d->layout = set_layout;
 }
 
+/* Lays out the given desktop and sends the resulting geometry, only the
+ * subtrees that were laid out again are visited */
+void commit_arrange(monitor_t *m, desktop_t *d)
+{
+	update_layout(m, d);
+	d->dirty = false;
+
+	if (d->root == NULL)
+		return;
+
+	bool monocle = (d->layout == LAYOUT_MONOCLE || (leaf_monocle && tiled_count(d) == 1));
+	commit_layout(m, d, d->root, monocle);
+
+	node_t *f = mon->desk->focus;
+	if (pointer_follows_focus && mon->desk == d && f != NULL && frozen_pointer->action == ACTION_NONE)
+		center_pointer(f->client->fullscreen ? m->rectangle : get_rectangle(f->client));
+}
+
+void commit_layout(monitor_t *m, desktop_t *d, node_t *n, bool monocle)
+{
+	if (n == NULL || !n->arranged)
+		return;
+
+	n->arranged = false;
+
+	if (!is_leaf(n)) {
+		commit_layout(m, d, n->first_child, monocle);
+		commit_layout(m, d, n->second_child, monocle);
+		return;
+	}
+
+	client_t *c = n->client;
+	unsigned int bw;
+	if ((borderless_monocle && is_tiled(c) && !c->pseudo_tiled && monocle) ||
+	    c->fullscreen)
+		bw = 0;
+	else
+		bw = c->border_width;
+
+	xcb_rectangle_t r = (c->fullscreen ? m->rectangle : get_rectangle(c));
+
+	window_configure(c, r, bw);
+	window_draw_border(n, d->focus == n, m == mon);
+	c->border_dirty = false;
+}
+
+/* Marks the given node, and thus its ancestors, for the next arrangement.
+ * The walk can't stop at the first dirty ancestor: new containers are born
+ * dirty before being linked to a clean tree. */
+void invalidate_layout(node_t *n)
+{
+	for (node_t *p = n; p != NULL; p = p->parent)
+		p->dirty = true;
+}
+
+void invalidate_tree(node_t *n)
+{
+	if (n == NULL)
+		return;
+	n->dirty = true;
+	invalidate_tree(n->first_child);
+	invalidate_tree(n->second_child);
+}
+
 void apply_layout(monitor_t *m, desktop_t *d, node_t *n, xcb_rectangle_t rect, xcb_rectangle_t root_rect)
 {
 	if (n == NULL)
 		return;
 
+	/* the subtree would be laid out exactly as it already is */
+	if (!n->dirty && n->rectangle.x == rect.x && n->rectangle.y == rect.y &&
+	    n->rectangle.width == rect.width && n->rectangle.height == rect.height)
+		return;
+
 	n->rectangle = rect;
+	n->dirty = false;
+	n->arranged = true;
 
 	if (is_leaf(n)) {
 
@@ -77,43 +171,27 @@ void apply_layout(monitor_t *m, desktop_t *d, node_t *n, xcb_rectangle_t rect, x
 		else
 			bw = n->client->border_width;
 
-		xcb_rectangle_t r;
-		if (!n->client->fullscreen) {
-			if (!n->client->floating) {
-				int wg = (gapless_monocle && d->layout == LAYOUT_MONOCLE ? 0 : d->window_gap);
-				if (n->client->pseudo_tiled) {
-				/* pseudo-tiled clients */
-					r = n->client->floating_rectangle;
-					if (center_pseudo_tiled) {
-						r.x = rect.x - bw + (rect.width - wg - r.width) / 2;
-						r.y = rect.y - bw + (rect.height - wg - r.height) / 2;
-					} else {
-						r.x = rect.x;
-						r.y = rect.y;
-					}
+		if (!n->client->fullscreen && !n->client->floating) {
+			int wg = (gapless_monocle && d->layout == LAYOUT_MONOCLE ? 0 : d->window_gap);
+			xcb_rectangle_t r;
+			if (n->client->pseudo_tiled) {
+			/* pseudo-tiled clients */
+				r = n->client->floating_rectangle;
+				if (center_pseudo_tiled) {
+					r.x = rect.x - bw + (rect.width - wg - r.width) / 2;
+					r.y = rect.y - bw + (rect.height - wg - r.height) / 2;
 				} else {
-					/* tiled clients */
-					r = rect;
-					int bleed = wg + 2 * bw;
-					r.width = (bleed < r.width ? r.width - bleed : 1);
-					r.height = (bleed < r.height ? r.height - bleed : 1);
+					r.x = rect.x;
+					r.y = rect.y;
 				}
-				n->client->tiled_rectangle = r;
 			} else {
-				/* floating clients */
-				r = n->client->floating_rectangle;
+				/* tiled clients */
+				r = rect;
+				int bleed = wg + 2 * bw;
+				r.width = (bleed < r.width ? r.width - bleed : 1);
+				r.height = (bleed < r.height ? r.height - bleed : 1);
 			}
-		} else {
-			/* fullscreen clients */
-			r = m->rectangle;
-		}
-
-		window_move_resize(n->client->window, r.x, r.y, r.width, r.height);
-		window_border_width(n->client->window, bw);
-		window_draw_border(n, d->focus == n, m == mon);
-
-		if (pointer_follows_focus && mon->desk->focus == n && frozen_pointer->action == ACTION_NONE) {
-			center_pointer(r);
+			n->client->tiled_rectangle = r;
 		}
 
 	} else {
@@ -147,6 +225,11 @@ void insert_node(monitor_t *m, desktop_t *d, node_t *n, node_t *f)
 
 	PRINTF("insert node %X\n", n->client->window);
 
+	wintable_add_node(d, n);
+	d->client_count++;
+	if (n->client->urgent)
+		d->urgent_count++;
+
 	/* n: new leaf node */
 	/* c: new container node */
 	/* f: focus or insertion anchor */
@@ -176,6 +259,7 @@ void insert_node(monitor_t *m, desktop_t *d, node_t *n, node_t *f)
 					p = f->parent;
 				}
 				f->split_mode = MODE_MANUAL;
+				update_layout(m, d);
 				xcb_rectangle_t rect = f->client->tiled_rectangle;
 				f->split_dir = (rect.width >= rect.height ? DIR_LEFT : DIR_UP);
 				if (f->client->private) {
@@ -279,6 +363,7 @@ void insert_node(monitor_t *m, desktop_t *d, node_t *n, node_t *f)
 		if (f->client != NULL && f->client->private)
 			update_privacy_level(f, true);
 	}
+	invalidate_layout(n);
 	if (n->client->private)
 		update_privacy_level(n, true);
 	if (d->focus == NULL)
@@ -288,13 +373,13 @@ void insert_node(monitor_t *m, desktop_t *d, node_t *n, node_t *f)
 	put_status(SBSC_MASK_REPORT);
 }
 
-void pseudo_focus(monitor_t *m, desktop_t *d, node_t *n)
+void pseudo_focus(desktop_t *d, node_t *n)
 {
 	if (n != NULL) {
 		stack(n, STACK_ABOVE);
 		if (d->focus != n) {
-			window_draw_border(d->focus, false, m == mon);
-			window_draw_border(n, true, m == mon);
+			invalidate_border(d->focus);
+			invalidate_border(n);
 		}
 	}
 	d->focus = n;
@@ -326,23 +411,21 @@ void focus_node(monitor_t *m, desktop_t *d, node_t *n)
 		}
 		if (n->client->urgent) {
 			n->client->urgent = false;
+			d->urgent_count--;
 			put_status(SBSC_MASK_REPORT);
 		}
 	}
 
 	if (mon != m) {
 		for (desktop_t *cd = mon->desk_head; cd != NULL; cd = cd->next)
-			window_draw_border(cd->focus, true, false);
+			invalidate_border(cd->focus);
 		for (desktop_t *cd = m->desk_head; cd != NULL; cd = cd->next)
-			if (cd != d)
-				window_draw_border(cd->focus, true, true);
-		if (d->focus == n)
-			window_draw_border(n, true, true);
+			invalidate_border(cd->focus);
 	}
 
 	if (d->focus != n) {
-		window_draw_border(d->focus, false, true);
-		window_draw_border(n, true, true);
+		invalidate_border(d->focus);
+		invalidate_border(n);
 	}
 
 	focus_desktop(m, d);
@@ -373,7 +456,8 @@ void focus_node(monitor_t *m, desktop_t *d, node_t *n)
 		}
 	}
 
-	if (pointer_follows_focus) {
+	/* otherwise the pointer is centered when the desktop is committed */
+	if (pointer_follows_focus && !d->dirty) {
 		center_pointer(get_rectangle(n->client));
 	}
 
@@ -396,6 +480,10 @@ node_t *make_node(void)
 	n->privacy_level = 0;
 	n->client = NULL;
 	n->vacant = false;
+	n->dirty = true;
+	n->arranged = false;
+	n->stack_entry = NULL;
+	n->history = NULL;
 	return n;
 }
 
@@ -408,19 +496,14 @@ client_t *make_client(xcb_window_t win, unsigned int border_width)
 	c->border_width = border_width;
 	c->pseudo_tiled = c->floating = c->fullscreen = false;
 	c->locked = c->sticky = c->urgent = c->private = c->icccm_focus = false;
-	xcb_icccm_get_wm_protocols_reply_t protocols;
-	if (xcb_icccm_get_wm_protocols_reply(dpy, xcb_icccm_get_wm_protocols(dpy, win, ewmh->WM_PROTOCOLS), &protocols, NULL) == 1) {
-		if (has_proto(WM_TAKE_FOCUS, &protocols))
-			c->icccm_focus = true;
-		xcb_icccm_get_wm_protocols_reply_wipe(&protocols);
-	}
+	c->border_dirty = false;
+	c->colormap = XCB_NONE;
+	c->depth = root_depth;
+	c->presel.pixmap = XCB_NONE;
 	c->num_states = 0;
-	xcb_ewmh_get_atoms_reply_t wm_state;
-	if (xcb_ewmh_get_wm_state_reply(ewmh, xcb_ewmh_get_wm_state(ewmh, win), &wm_state, NULL) == 1) {
-		for (unsigned int i = 0; i < wm_state.atoms_len && i < MAX_STATE; i++)
-			ewmh_wm_state_add(c, wm_state.atoms[i]);
-		xcb_ewmh_get_atoms_reply_wipe(&wm_state);
-	}
+	c->sent_rectangle = (xcb_rectangle_t) {0, 0, 0, 0};
+	c->sent_border_width = -1;
+	c->sent_border_mask = 0;
 	return c;
 }
 
@@ -457,11 +540,11 @@ void reset_mode(coordinates_t *loc)
 {
 	if (loc->node != NULL) {
 		loc->node->split_mode = MODE_AUTOMATIC;
-		window_draw_border(loc->node, loc->desktop->focus == loc->node, mon == loc->monitor);
+		invalidate_border(loc->node);
 	} else if (loc->desktop != NULL) {
 		for (node_t *a = first_extrema(loc->desktop->root); a != NULL; a = next_leaf(a, loc->desktop->root)) {
 			a->split_mode = MODE_AUTOMATIC;
-			window_draw_border(a, loc->desktop->focus == a, mon == loc->monitor);
+			invalidate_border(a);
 		}
 	}
 }
@@ -625,6 +708,8 @@ node_t *nearest_neighbor(monitor_t *m, desktop_t *d, node_t *n, direction_t dir,
 	    (d->layout == LAYOUT_MONOCLE && is_tiled(n->client)))
 		return NULL;
 
+	update_layout(m, d);
+
 	node_t *nearest = NULL;
 	if (history_aware_focus)
 		nearest = nearest_from_history(m, d, n, dir, sel);
@@ -787,6 +872,8 @@ node_t *find_biggest(monitor_t *m, desktop_t *d, node_t *n, client_select_t sel)
 	if (d == NULL)
 		return NULL;
 
+	update_layout(m, d);
+
 	node_t *r = NULL;
 	int r_area = tiled_area(r);
 	coordinates_t ref = {m, d, n};
@@ -824,6 +911,8 @@ void rotate_tree(node_t *n, int deg)
 		n->split_ratio = 1.0 - n->split_ratio;
 	}
 
+	invalidate_layout(n);
+
 	if (deg != 180) {
 		if (n->split_type == TYPE_HORIZONTAL)
 			n->split_type = TYPE_VERTICAL;
@@ -865,6 +954,7 @@ void flip_tree(node_t *n, flip_t flp)
 		n->first_child = n->second_child;
 		n->second_child = tmp;
 		n->split_ratio = 1.0 - n->split_ratio;
+		invalidate_layout(n);
 	}
 
 	flip_tree(n->first_child, flp);
@@ -876,7 +966,10 @@ void equalize_tree(node_t *n)
 	if (n == NULL || n->vacant) {
 		return;
 	} else {
-		n->split_ratio = split_ratio;
+		if (n->split_ratio != split_ratio) {
+			n->split_ratio = split_ratio;
+			invalidate_layout(n);
+		}
 		equalize_tree(n->first_child);
 		equalize_tree(n->second_child);
 	}
@@ -892,8 +985,10 @@ int balance_tree(node_t *n)
 		int b1 = balance_tree(n->first_child);
 		int b2 = balance_tree(n->second_child);
 		int b = b1 + b2;
-		if (b1 > 0 && b2 > 0)
+		if (b1 > 0 && b2 > 0 && n->split_ratio != (double) b1 / b) {
 			n->split_ratio = (double) b1 / b;
+			invalidate_layout(n);
+		}
 		return b;
 	}
 }
@@ -905,6 +1000,10 @@ void unlink_node(monitor_t *m, desktop_t *d, node_t *n)
 
 	PRINTF("unlink node %X\n", n->client->window);
 
+	d->client_count--;
+	if (n->client->urgent)
+		d->urgent_count--;
+
 	node_t *p = n->parent;
 
 	if (p == NULL) {
@@ -942,6 +1041,7 @@ void unlink_node(monitor_t *m, desktop_t *d, node_t *n)
 		n->parent = NULL;
 		free(p);
 		update_vacant_state(b->parent);
+		invalidate_layout(b);
 
 		if (n == d->focus) {
 			d->focus = history_get_node(d, n);
@@ -966,6 +1066,8 @@ void remove_node(monitor_t *m, desktop_t *d, node_t *n)
 	unlink_node(m, d, n);
 	history_remove(d, n);
 	remove_stack_node(n);
+	wintable_remove_node(n);
+	free_presel_pixmap(n->client);
 	free(n->client);
 	free(n);
 
@@ -983,6 +1085,9 @@ void destroy_tree(node_t *n)
 	node_t *first_tree = n->first_child;
 	node_t *second_tree = n->second_child;
 	if (n->client != NULL) {
+		remove_stack_node(n);
+		wintable_remove_node(n);
+		free_presel_pixmap(n->client);
 		free(n->client);
 		num_clients--;
 	}
@@ -1028,6 +1133,8 @@ bool swap_nodes(monitor_t *m1, desktop_t *d1, node_t *n1, monitor_t *m2, desktop
 	n2->birth_rotation = br1;
 	n1->privacy_level = pl2;
 	n2->privacy_level = pl1;
+	invalidate_layout(n1);
+	invalidate_layout(n2);
 
 	if (n1->vacant != n2->vacant) {
 		update_vacant_state(n1->parent);
@@ -1048,12 +1155,19 @@ bool swap_nodes(monitor_t *m1, desktop_t *d1, node_t *n1, monitor_t *m2, desktop
 			d2->root = n1;
 		if (d2->focus == n2)
 			d2->focus = n1;
+		if (n1->client->urgent != n2->client->urgent) {
+			int delta = (n1->client->urgent ? 1 : -1);
+			d1->urgent_count -= delta;
+			d2->urgent_count += delta;
+		}
 
 		if (m1 != m2) {
 			translate_client(m2, m1, n2->client);
 			translate_client(m1, m2, n1->client);
 		}
 
+		wintable_add_node(d2, n1);
+		wintable_add_node(d1, n2);
 		ewmh_set_wm_desktop(n1, d2);
 		ewmh_set_wm_desktop(n2, d1);
 		history_swap_nodes(m1, d1, n1, m2, d2, n2);
@@ -1111,7 +1225,7 @@ bool transfer_node(monitor_t *ms, desktop_t *ds, node_t *ns, monitor_t *md, desk
 		if (focused)
 			focus_node(md, dd, ns);
 		else if (active)
-			pseudo_focus(md, dd, ns);
+			pseudo_focus(dd, ns);
 	} else {
 		if (focused)
 			update_current();
@@ -26,9 +26,14 @@
 #define BSPWM_TREE_H
 
 void arrange(monitor_t *m, desktop_t *d);
+void update_layout(monitor_t *m, desktop_t *d);
+void commit_arrange(monitor_t *m, desktop_t *d);
+void commit_layout(monitor_t *m, desktop_t *d, node_t *n, bool monocle);
+void invalidate_layout(node_t *n);
+void invalidate_tree(node_t *n);
 void apply_layout(monitor_t *m, desktop_t *d, node_t *n, xcb_rectangle_t rect, xcb_rectangle_t root_rect);
 void insert_node(monitor_t *m, desktop_t *d, node_t *n, node_t *f);
-void pseudo_focus(monitor_t *m, desktop_t *d, node_t *n);
+void pseudo_focus(desktop_t *d, node_t *n);
 void focus_node(monitor_t *m, desktop_t *d, node_t *n);
 void update_current(void);
 node_t *make_node(void);
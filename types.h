@@ -26,6 +26,7 @@
 #define BSPWM_TYPES_H
 
 #include <stdbool.h>
+#include <time.h>
 #include <xcb/xcb.h>
 #include <xcb/randr.h>
 #include <xcb/xcb_event.h>
@@ -153,6 +154,17 @@ typedef struct {
 	bool local;
 } desktop_select_t;
 
+typedef struct {
+	xcb_pixmap_t pixmap;
+	uint16_t width;
+	uint16_t height;
+	unsigned int border_width;
+	direction_t split_dir;
+	double split_ratio;
+	uint32_t border_color;
+	uint32_t presel_color;
+} border_pixmap_t;
+
 typedef struct {
 	xcb_window_t window;
 	char class_name[3 * SMALEN / 2];
@@ -174,8 +186,19 @@ typedef struct {
 	uint16_t max_height;
 	xcb_atom_t wm_state[MAX_STATE];
 	int num_states;
+	bool border_dirty;			/* border needs to be redrawn */
+	xcb_colormap_t colormap;
+	uint8_t depth;
+	border_pixmap_t presel;			/* border drawn for a manual split */
+	xcb_rectangle_t sent_rectangle;		/* geometry last sent to the server, empty if unknown */
+	int sent_border_width;			/* negative if unknown */
+	uint32_t sent_border_mask;		/* border attribute last sent, 0 if unknown */
+	uint32_t sent_border_value;
 } client_t;
 
+typedef struct stacking_list_t stacking_list_t;
+typedef struct history_t history_t;
+
 typedef struct node_t node_t;
 struct node_t {
 	split_type_t split_type;
@@ -186,16 +209,24 @@ struct node_t {
 	xcb_rectangle_t rectangle;
 	bool vacant;				/* vacant nodes only hold floating clients */
 	int privacy_level;
+	bool dirty;				/* the inputs of its layout changed */
+	bool arranged;				/* its geometry awaits the commit phase */
 	node_t *first_child;
 	node_t *second_child;
 	node_t *parent;
 	client_t *client;			/* NULL except for leaves */
+	stacking_list_t *stack_entry;		/* NULL if not stacked */
+	history_t *history;			/* latest history entry */
 };
 
+typedef struct monitor_t monitor_t;
+
 typedef struct desktop_t desktop_t;
 struct desktop_t {
 	char name[SMALEN];
 	layout_t layout;
+	layout_t arranged_layout;		/* effective layout of the last arrangement */
+	history_t *history;			/* latest history entry without a node */
 	node_t *root;
 	node_t *focus;
 	desktop_t *prev;
@@ -207,9 +238,14 @@ struct desktop_t {
 	int window_gap;
 	unsigned int border_width;
 	bool floating;
+	bool dirty;				/* arrangement pending until the next commit */
+	bool laid_out;				/* layout computed since the last arrangement */
+	unsigned int client_count;		/* leaves of its tree */
+	unsigned int urgent_count;		/* urgent ones among them */
+	monitor_t *monitor;
+	unsigned int index;			/* global ordinal, see lookup.c */
 };
 
-typedef struct monitor_t monitor_t;
 struct monitor_t {
 	char name[SMALEN];
 	xcb_randr_output_t id;
@@ -226,6 +262,8 @@ struct monitor_t {
 	monitor_t *prev;
 	monitor_t *next;
 	int num_sticky;
+	unsigned int desk_index;		/* ordinal of the first desktop */
+	unsigned int desk_count;
 };
 
 typedef struct {
@@ -234,46 +272,158 @@ typedef struct {
 	node_t *node;
 } coordinates_t;
 
-typedef struct history_t history_t;
 struct history_t {
 	coordinates_t loc;
-	bool latest;
+	bool latest;				/* no later entry has the same node, or desktop if empty */
+	unsigned long stamp;
 	history_t *prev;
 	history_t *next;
 };
 
-typedef struct stacking_list_t stacking_list_t;
+typedef enum {
+	LAYER_TILED,
+	LAYER_FLOATING,
+	LAYER_FULLSCREEN,
+	LAYER_LENGTH
+} stack_layer_t;
+
 struct stacking_list_t {
 	node_t *node;
+	stack_layer_t layer;
+	bool dirty;				/* not yet restacked on the server */
+	bool raise;
 	stacking_list_t *prev;
 	stacking_list_t *next;
 };
 
+typedef enum {
+	WATCH_DISPLAY,
+	WATCH_SOCKET,
+	WATCH_SIGNAL,
+	WATCH_RULE,
+	WATCH_SUBSCRIBER,
+	WATCH_BATCH,
+	WATCH_COPROCESS
+} watch_kind_t;
+
+typedef struct {
+	watch_kind_t kind;
+	void *data;
+} watch_t;
+
+typedef struct batch_t batch_t;
+struct batch_t {
+	int fd;
+	char *buf;
+	size_t len;
+	size_t cap;
+	char *out;
+	size_t out_len;
+	size_t out_cap;
+	uint32_t events;
+	bool eof;
+	watch_t watch;
+	batch_t *prev;
+	batch_t *next;
+};
+
+typedef enum {
+	OVERFLOW_DROP_OLDEST,
+	OVERFLOW_COALESCE,
+	OVERFLOW_DISCONNECT
+} overflow_policy_t;
+
+typedef struct {
+	char *data;
+	size_t len;
+	bool report;
+} status_message_t;
+
+#define SUBSCRIBER_QUEUE_LEN  128
+
 typedef struct subscriber_list_t subscriber_list_t;
 struct subscriber_list_t {
 	int fd;
 	FILE *stream;
 	int field;
+	status_message_t queue[SUBSCRIBER_QUEUE_LEN];
+	unsigned int head;
+	unsigned int count;
+	size_t offset;
+	bool pending_report;
+	bool blocked;
+	char *last_report;			/* latest report queued, NULL if none */
+	size_t last_report_len;
+	unsigned long sent;
+	unsigned long dropped;
+	unsigned long coalesced;
+	unsigned long duplicates;		/* reports identical to the previous one */
+	watch_t watch;
 	subscriber_list_t *prev;
 	subscriber_list_t *next;
 };
 
+/* Fields of a consequence set by a rule effect */
+typedef enum {
+	CSQ_PSEUDO_TILED = 1 << 0,
+	CSQ_FLOATING     = 1 << 1,
+	CSQ_FULLSCREEN   = 1 << 2,
+	CSQ_LOCKED       = 1 << 3,
+	CSQ_STICKY       = 1 << 4,
+	CSQ_PRIVATE      = 1 << 5,
+	CSQ_CENTER       = 1 << 6,
+	CSQ_FOLLOW       = 1 << 7,
+	CSQ_MANAGE       = 1 << 8,
+	CSQ_FOCUS        = 1 << 9,
+	CSQ_BORDER       = 1 << 10,
+	CSQ_MONITOR      = 1 << 11,
+	CSQ_DESKTOP      = 1 << 12,
+	CSQ_NODE         = 1 << 13,
+	CSQ_SPLIT_DIR    = 1 << 14,
+	CSQ_SPLIT_RATIO  = 1 << 15
+} consequence_field_t;
+
+/* A rule effect compiled once: the fields it sets and their values, the
+ * booleans being stored as bits of `values` */
+typedef struct {
+	uint32_t mask;
+	uint32_t values;
+	char *monitor_desc;
+	char *desktop_desc;
+	char *node_desc;
+	direction_t split_dir;
+	double split_ratio;
+} rule_delta_t;
+
 typedef struct rule_t rule_t;
 struct rule_t {
 	char cause[MAXLEN];
 	char effect[MAXLEN];
+	rule_delta_t delta;
 	bool one_shot;
+	unsigned long order;			/* rank in the declaration order */
 	rule_t *prev;
 	rule_t *next;
+	rule_t *cause_prev;			/* neighbours among the rules of the same cause */
+	rule_t *cause_next;
+};
+
+/* Rules sharing the same cause, chained in a bucket of the rule table */
+typedef struct rule_cause_t rule_cause_t;
+struct rule_cause_t {
+	rule_t *head;
+	rule_t *tail;
+	rule_cause_t *next;
 };
 
 typedef struct {
 	char class_name[3 * SMALEN / 2];
 	char instance_name[3 * SMALEN / 2];
-	char monitor_desc[MAXLEN];
-	char desktop_desc[MAXLEN];
-	char node_desc[MAXLEN];
-	char split_dir[SMALEN];
+	char *monitor_desc;			/* owned, NULL if unset */
+	char *desktop_desc;
+	char *node_desc;
+	bool presel;				/* split_dir is set */
+	direction_t split_dir;
 	double split_ratio;
 	uint16_t min_width;
 	uint16_t max_width;
@@ -290,17 +440,68 @@ typedef struct {
 	bool manage;
 	bool focus;
 	bool border;
+	bool icccm_focus;
+	xcb_colormap_t colormap;
+	uint8_t depth;
+	xcb_rectangle_t rectangle;
+	xcb_atom_t wm_state[MAX_STATE];
+	int num_states;
 } rule_consequence_t;
 
+/* Requests issued for a window before it is scheduled, a zero sequence
+ * number marks a reply that was already consumed */
+typedef struct prefetch_t prefetch_t;
+struct prefetch_t {
+	xcb_window_t win;
+	xcb_get_window_attributes_cookie_t attributes;
+	xcb_get_property_cookie_t window_type;
+	xcb_get_property_cookie_t wm_state;
+	xcb_get_property_cookie_t normal_hints;
+	xcb_get_property_cookie_t transient_for;
+	xcb_get_property_cookie_t wm_class;
+	xcb_get_property_cookie_t protocols;
+	xcb_get_geometry_cookie_t geometry;
+	prefetch_t *prev;
+	prefetch_t *next;
+};
+
 typedef struct pending_rule_t pending_rule_t;
 struct pending_rule_t {
-	int fd;
+	int fd;					/* -1 if answered by the coprocess */
+	unsigned int id;			/* request sent to the coprocess */
+	pid_t pid;
+	bool queued;				/* waiting for a free slot */
+	struct timespec started;
 	xcb_window_t win;
 	rule_consequence_t *csq;
+	char answer[BUFSIZ];			/* output collected so far */
+	size_t len;
+	watch_t watch;
 	pending_rule_t *prev;
 	pending_rule_t *next;
 };
 
+/* Persistent external rules command: requests are written to its standard
+ * input and answers read from its standard output, one per line */
+typedef struct {
+	pid_t pid;
+	int in;					/* -1 if not running */
+	int out;
+	unsigned int last_id;
+	char buf[BUFSIZ];
+	size_t len;
+	watch_t watch;
+} rule_coprocess_t;
+
+typedef struct window_entry_t window_entry_t;
+struct window_entry_t {
+	xcb_window_t win;
+	node_t *node;
+	desktop_t *desktop;
+	pending_rule_t *rule;
+	window_entry_t *next;
+};
+
 typedef struct {
 	xcb_point_t position;
 	pointer_action_t action;
@@ -324,4 +525,20 @@ typedef struct {
 	unsigned int distance;
 } fence_distance_t;
 
+typedef struct gc_cache_t gc_cache_t;
+struct gc_cache_t {
+	uint8_t depth;
+	xcb_gcontext_t gc;
+	gc_cache_t *next;
+};
+
+typedef struct color_t color_t;
+struct color_t {
+	xcb_colormap_t colormap;
+	char name[MAXLEN];
+	uint32_t pixel;
+	bool valid;
+	color_t *next;
+};
+
 #endif
@@ -25,52 +25,154 @@
 #include <stdlib.h>
 #include <string.h>
 #include "bspwm.h"
+#include "backend.h"
 #include "ewmh.h"
 #include "monitor.h"
 #include "query.h"
 #include "rule.h"
 #include "settings.h"
 #include "stack.h"
+#include "stats.h"
 #include "tree.h"
 #include "subscribe.h"
 #include "messages.h"
+#include "wintable.h"
 #include "window.h"
 
+prefetch_t *make_prefetch(xcb_window_t win)
+{
+	prefetch_t *pf = malloc(sizeof(prefetch_t));
+	pf->prev = pf->next = NULL;
+	pf->win = win;
+	pf->attributes = xcb_get_window_attributes(dpy, win);
+	pf->window_type = xcb_ewmh_get_wm_window_type(ewmh, win);
+	pf->wm_state = xcb_ewmh_get_wm_state(ewmh, win);
+	pf->normal_hints = xcb_icccm_get_wm_normal_hints(dpy, win);
+	pf->transient_for = xcb_icccm_get_wm_transient_for(dpy, win);
+	pf->wm_class = xcb_icccm_get_wm_class(dpy, win);
+	pf->protocols = xcb_icccm_get_wm_protocols(dpy, win, ewmh->WM_PROTOCOLS);
+	pf->geometry = xcb_get_geometry(dpy, win);
+	return pf;
+}
+
+/* Issues the requests needed to schedule the given window without waiting
+ * for their replies */
+void prefetch_window(xcb_window_t win)
+{
+	prefetch_t *pf = make_prefetch(win);
+	if (prefetch_head == NULL) {
+		prefetch_head = prefetch_tail = pf;
+	} else {
+		prefetch_tail->next = pf;
+		pf->prev = prefetch_tail;
+		prefetch_tail = pf;
+	}
+}
+
+/* Returns the prefetched requests of the given window, unlinked from the
+ * list, issuing them if needed */
+prefetch_t *take_prefetch(xcb_window_t win)
+{
+	for (prefetch_t *pf = prefetch_head; pf != NULL; pf = pf->next)
+		if (pf->win == win) {
+			unlink_prefetch(pf);
+			return pf;
+		}
+	return make_prefetch(win);
+}
+
+void unlink_prefetch(prefetch_t *pf)
+{
+	prefetch_t *a = pf->prev;
+	prefetch_t *b = pf->next;
+	if (a != NULL)
+		a->next = b;
+	if (b != NULL)
+		b->prev = a;
+	if (pf == prefetch_head)
+		prefetch_head = b;
+	if (pf == prefetch_tail)
+		prefetch_tail = a;
+	pf->prev = pf->next = NULL;
+}
+
+/* Frees the given requests, discarding the replies that weren't consumed */
+void free_prefetch(prefetch_t *pf)
+{
+	unsigned int sequences[] = {
+		pf->attributes.sequence, pf->window_type.sequence, pf->wm_state.sequence,
+		pf->normal_hints.sequence, pf->transient_for.sequence, pf->wm_class.sequence,
+		pf->protocols.sequence, pf->geometry.sequence
+	};
+	for (unsigned int i = 0; i < LENGTH(sequences); i++)
+		if (sequences[i] != 0)
+			xcb_discard_reply(dpy, sequences[i]);
+	free(pf);
+}
+
+void remove_prefetch(prefetch_t *pf)
+{
+	unlink_prefetch(pf);
+	free_prefetch(pf);
+}
+
 void schedule_window(xcb_window_t win)
 {
 	coordinates_t loc;
 	uint8_t override_redirect = 0;
-	xcb_get_window_attributes_reply_t *wa = xcb_get_window_attributes_reply(dpy, xcb_get_window_attributes(dpy, win), NULL);
+	xcb_colormap_t colormap = XCB_NONE;
+	prefetch_t *pf = take_prefetch(win);
+	xcb_get_window_attributes_reply_t *wa = xcb_get_window_attributes_reply(dpy, pf->attributes, NULL);
+	pf->attributes.sequence = 0;
 
 	if (wa != NULL) {
 		override_redirect = wa->override_redirect;
+		colormap = wa->colormap;
 		free(wa);
 	}
 
-	if (override_redirect || locate_window(win, &loc))
-		return;
-
 	/* ignore pending windows */
-	for (pending_rule_t *pr = pending_rule_head; pr != NULL; pr = pr->next)
-		if (pr->win == win)
-			return;
+	window_entry_t *we = wintable_find(win);
+
+	if (override_redirect || locate_window(win, &loc) || (we != NULL && we->rule != NULL)) {
+		free_prefetch(pf);
+		return;
+	}
 
 	rule_consequence_t *csq = make_rule_conquence();
-	apply_rules(win, csq);
+	csq->colormap = colormap;
+	apply_rules(win, csq, pf);
+
+	xcb_get_geometry_reply_t *geo = xcb_get_geometry_reply(dpy, pf->geometry, NULL);
+	pf->geometry.sequence = 0;
+	if (geo != NULL) {
+		csq->rectangle = (xcb_rectangle_t) {geo->x, geo->y, geo->width, geo->height};
+		csq->depth = geo->depth;
+	}
+	free(geo);
+
+	xcb_icccm_get_wm_protocols_reply_t protocols;
+	if (xcb_icccm_get_wm_protocols_reply(dpy, pf->protocols, &protocols, NULL) == 1) {
+		if (has_proto(WM_TAKE_FOCUS, &protocols))
+			csq->icccm_focus = true;
+		xcb_icccm_get_wm_protocols_reply_wipe(&protocols);
+	}
+	pf->protocols.sequence = 0;
+
+	free_prefetch(pf);
+
 	if (!schedule_rules(win, csq)) {
-		manage_window(win, csq, -1);
-		free(csq);
+		manage_window(win, csq);
+		free_rule_consequence(csq);
 	}
 }
 
-void manage_window(xcb_window_t win, rule_consequence_t *csq, int fd)
+void manage_window(xcb_window_t win, rule_consequence_t *csq)
 {
 	monitor_t *m = mon;
 	desktop_t *d = mon->desk;
 	node_t *f = mon->desk->focus;
 
-	parse_rule_consequence(fd, csq);
-
 	if (!csq->manage) {
 		disable_floating_atom(win);
 		window_show(win);
@@ -79,7 +181,7 @@ void manage_window(xcb_window_t win, rule_consequence_t *csq, int fd)
 
 	PRINTF("manage %X\n", win);
 
-	if (csq->node_desc[0] != '\0') {
+	if (csq->node_desc != NULL) {
 		coordinates_t ref = {m, d, f};
 		coordinates_t trg = {NULL, NULL, NULL};
 		if (node_from_desc(csq->node_desc, &ref, &trg)) {
@@ -87,7 +189,7 @@ void manage_window(xcb_window_t win, rule_consequence_t *csq, int fd)
 			d = trg.desktop;
 			f = trg.node;
 		}
-	} else if (csq->desktop_desc[0] != '\0') {
+	} else if (csq->desktop_desc != NULL) {
 		coordinates_t ref = {m, d, NULL};
 		coordinates_t trg = {NULL, NULL, NULL};
 		if (desktop_from_desc(csq->desktop_desc, &ref, &trg)) {
@@ -95,7 +197,7 @@ void manage_window(xcb_window_t win, rule_consequence_t *csq, int fd)
 			d = trg.desktop;
 			f = trg.desktop->focus;
 		}
-	} else if (csq->monitor_desc[0] != '\0') {
+	} else if (csq->monitor_desc != NULL) {
 		coordinates_t ref = {m, NULL, NULL};
 		coordinates_t trg = {NULL, NULL, NULL};
 		if (monitor_from_desc(csq->monitor_desc, &ref, &trg)) {
@@ -111,12 +213,9 @@ void manage_window(xcb_window_t win, rule_consequence_t *csq, int fd)
 		f = mon->desk->focus;
 	}
 
-	if (csq->split_dir[0] != '\0' && f != NULL) {
-		direction_t dir;
-		if (parse_direction(csq->split_dir, &dir)) {
-			f->split_mode = MODE_MANUAL;
-			f->split_dir = dir;
-		}
+	if (csq->presel && f != NULL) {
+		f->split_mode = MODE_MANUAL;
+		f->split_dir = csq->split_dir;
 	}
 
 	if (csq->split_ratio != 0 && f != NULL) {
@@ -124,7 +223,14 @@ void manage_window(xcb_window_t win, rule_consequence_t *csq, int fd)
 	}
 
 	client_t *c = make_client(win, csq->border ? d->border_width : 0);
-	update_floating_rectangle(c);
+	c->icccm_focus = csq->icccm_focus;
+	c->colormap = csq->colormap;
+	if (csq->depth != 0)
+		c->depth = csq->depth;
+	cache_border_colors(c->colormap);
+	for (int i = 0; i < csq->num_states; i++)
+		ewmh_wm_state_add(c, csq->wm_state[i]);
+	c->floating_rectangle = csq->rectangle;
 	if (c->floating_rectangle.x == 0 && c->floating_rectangle.y == 0)
 		csq->center = true;
 	c->min_width = csq->min_width;
@@ -151,9 +257,9 @@ void manage_window(xcb_window_t win, rule_consequence_t *csq, int fd)
 	disable_floating_atom(c->window);
 	set_pseudo_tiled(n, csq->pseudo_tiled);
 	set_floating(n, csq->floating);
-	set_locked(m, d, n, csq->locked);
+	set_locked(n, csq->locked);
 	set_sticky(m, d, n, csq->sticky);
-	set_private(m, d, n, csq->private);
+	set_private(n, csq->private);
 
 	if (d->focus != NULL && d->focus->client->fullscreen)
 		set_fullscreen(d->focus, false);
@@ -167,12 +273,12 @@ void manage_window(xcb_window_t win, rule_consequence_t *csq, int fd)
 	if (give_focus)
 		focus_node(m, d, n);
 	else if (csq->focus)
-		pseudo_focus(m, d, n);
+		pseudo_focus(d, n);
 	else
 		stack(n, STACK_ABOVE);
 
 	uint32_t values[] = {CLIENT_EVENT_MASK | (focus_follows_pointer ? XCB_EVENT_MASK_ENTER_WINDOW : 0)};
-	xcb_change_window_attributes(dpy, c->window, XCB_CW_EVENT_MASK, values);
+	backend->change_window_attributes(c->window, XCB_CW_EVENT_MASK, values);
 
 	if (visible) {
 		if (d == m->desk)
@@ -183,7 +289,7 @@ void manage_window(xcb_window_t win, rule_consequence_t *csq, int fd)
 
 	/* the same function is already called in `focus_node` but has no effects on unmapped windows */
 	if (give_focus)
-		xcb_set_input_focus(dpy, XCB_INPUT_FOCUS_POINTER_ROOT, win, XCB_CURRENT_TIME);
+		backend->set_input_focus(win);
 
 	num_clients++;
 	ewmh_set_wm_desktop(n, d);
@@ -201,18 +307,20 @@ void unmanage_window(xcb_window_t win)
 			frozen_pointer->action = ACTION_NONE;
 		arrange(loc.monitor, loc.desktop);
 	} else {
-		for (pending_rule_t *pr = pending_rule_head; pr != NULL; pr = pr->next) {
-			if (pr->win == win) {
-				remove_pending_rule(pr);
-				return;
-			}
-		}
+		window_entry_t *we = wintable_find(win);
+		if (we != NULL && we->rule != NULL)
+			remove_pending_rule(we->rule);
 	}
 }
 
 void window_draw_border(node_t *n, bool focused_window, bool focused_monitor)
 {
-	if (n == NULL || n->client->border_width < 1) {
+	if (n == NULL)
+		return;
+
+	if (n->client->border_width < 1) {
+		/* a border drawn before the width was set to zero */
+		free_presel_pixmap(n->client);
 		return;
 	}
 
@@ -220,70 +328,151 @@ void window_draw_border(node_t *n, bool focused_window, bool focused_monitor)
 	uint32_t border_color_pxl = get_border_color(n->client, focused_window, focused_monitor);
 
 	if (n->split_mode == MODE_AUTOMATIC) {
-		xcb_change_window_attributes(dpy, win, XCB_CW_BORDER_PIXEL, &border_color_pxl);
+		free_presel_pixmap(n->client);
+		client_border_attribute(n->client, XCB_CW_BORDER_PIXEL, border_color_pxl);
 	} else {
-		unsigned int border_width = n->client->border_width;
 		uint32_t presel_border_color_pxl;
-		get_color(presel_border_color, win, &presel_border_color_pxl);
-
+		get_color(presel_border_color, n->client->colormap, &presel_border_color_pxl);
 		xcb_rectangle_t actual_rectangle = get_rectangle(n->client);
+		border_pixmap_t *bp = &n->client->presel;
+
+		if (bp->pixmap == XCB_NONE ||
+		    bp->width != actual_rectangle.width ||
+		    bp->height != actual_rectangle.height ||
+		    bp->border_width != n->client->border_width ||
+		    bp->split_dir != n->split_dir ||
+		    bp->split_ratio != n->split_ratio ||
+		    bp->border_color != border_color_pxl ||
+		    bp->presel_color != presel_border_color_pxl) {
+			free_presel_pixmap(n->client);
+			bp->width = actual_rectangle.width;
+			bp->height = actual_rectangle.height;
+			bp->border_width = n->client->border_width;
+			bp->split_dir = n->split_dir;
+			bp->split_ratio = n->split_ratio;
+			bp->border_color = border_color_pxl;
+			bp->presel_color = presel_border_color_pxl;
+			bp->pixmap = make_presel_pixmap(win, n->client->depth, bp);
+		}
+
+		client_border_attribute(n->client, XCB_CW_BORDER_PIXMAP, bp->pixmap);
+	}
+}
+
+/* Draws the border of a preselected window in a new pixmap */
+xcb_pixmap_t make_presel_pixmap(xcb_window_t win, uint8_t depth, border_pixmap_t *bp)
+{
+	unsigned int border_width = bp->border_width;
+	uint16_t width = bp->width;
+	uint16_t height = bp->height;
+
+	uint16_t full_width = width + 2 * border_width;
+	uint16_t full_height = height + 2 * border_width;
+
+	xcb_rectangle_t border_rectangles[] =
+	{
+		{ width, 0, 2 * border_width, height + 2 * border_width },
+		{ 0, height, width + 2 * border_width, 2 * border_width }
+	};
+
+	xcb_rectangle_t presel_rectangles[2];
+
+	xcb_pixmap_t pixmap = backend->generate_id();
+	backend->create_pixmap(depth, pixmap, win, full_width, full_height);
+
+	xcb_gcontext_t gc = get_gc(depth, pixmap);
+
+	backend->change_gc(gc, XCB_GC_FOREGROUND, &bp->border_color);
+	backend->poly_fill_rectangle(pixmap, gc, LENGTH(border_rectangles), border_rectangles);
+
+	uint16_t fence = (int16_t) (bp->split_ratio * ((bp->split_dir == DIR_UP || bp->split_dir == DIR_DOWN) ? height : width));
+	switch (bp->split_dir) {
+		case DIR_UP:
+			presel_rectangles[0] = (xcb_rectangle_t) {width, 0, 2 * border_width, fence};
+			presel_rectangles[1] = (xcb_rectangle_t) {0, height + border_width, full_width, border_width};
+			break;
+		case DIR_DOWN:
+			presel_rectangles[0] = (xcb_rectangle_t) {width, fence + 1, 2 * border_width, height + border_width - (fence + 1)};
+			presel_rectangles[1] = (xcb_rectangle_t) {0, height, full_width, border_width};
+			break;
+		case DIR_LEFT:
+			presel_rectangles[0] = (xcb_rectangle_t) {0, height, fence, 2 * border_width};
+			presel_rectangles[1] = (xcb_rectangle_t) {width + border_width, 0, border_width, full_height};
+			break;
+		case DIR_RIGHT:
+			presel_rectangles[0] = (xcb_rectangle_t) {fence + 1, height, width + border_width - (fence + 1), 2 * border_width};
+			presel_rectangles[1] = (xcb_rectangle_t) {width, 0, border_width, full_height};
+			break;
+	}
+	backend->change_gc(gc, XCB_GC_FOREGROUND, &bp->presel_color);
+	backend->poly_fill_rectangle(pixmap, gc, LENGTH(presel_rectangles), presel_rectangles);
+
+	return pixmap;
+}
+
+void free_presel_pixmap(client_t *c)
+{
+	if (c->presel.pixmap == XCB_NONE)
+		return;
+	backend->free_pixmap(c->presel.pixmap);
+	c->presel.pixmap = XCB_NONE;
+}
+
+/* Returns the graphics context shared by the drawables of the given depth,
+ * the drawable is only used to create it */
+xcb_gcontext_t get_gc(uint8_t depth, xcb_drawable_t d)
+{
+	for (gc_cache_t *g = gc_head; g != NULL; g = g->next)
+		if (g->depth == depth)
+			return g->gc;
+	gc_cache_t *g = malloc(sizeof(gc_cache_t));
+	g->depth = depth;
+	g->gc = backend->generate_id();
+	backend->create_gc(g->gc, d);
+	g->next = gc_head;
+	gc_head = g;
+	return g->gc;
+}
+
+void empty_gcs(void)
+{
+	while (gc_head != NULL) {
+		gc_cache_t *next = gc_head->next;
+		backend->free_gc(gc_head->gc);
+		free(gc_head);
+		gc_head = next;
+	}
+}
 
-		uint16_t width = actual_rectangle.width;
-		uint16_t height = actual_rectangle.height;
-
-		uint16_t full_width = width + 2 * border_width;
-		uint16_t full_height = height + 2 * border_width;
-
-		xcb_rectangle_t border_rectangles[] =
-		{
-			{ width, 0, 2 * border_width, height + 2 * border_width },
-			{ 0, height, width + 2 * border_width, 2 * border_width }
-		};
-
-		xcb_rectangle_t *presel_rectangles;
-
-		uint8_t win_depth = root_depth;
-		xcb_get_geometry_reply_t *geo = xcb_get_geometry_reply(dpy, xcb_get_geometry(dpy, win), NULL);
-		if (geo != NULL)
-			win_depth = geo->depth;
-		free(geo);
-
-		xcb_pixmap_t pixmap = xcb_generate_id(dpy);
-		xcb_create_pixmap(dpy, win_depth, pixmap, win, full_width, full_height);
-
-		xcb_gcontext_t gc = xcb_generate_id(dpy);
-		xcb_create_gc(dpy, gc, pixmap, 0, NULL);
-
-		xcb_change_gc(dpy, gc, XCB_GC_FOREGROUND, &border_color_pxl);
-		xcb_poly_fill_rectangle(dpy, pixmap, gc, LENGTH(border_rectangles), border_rectangles);
-
-		uint16_t fence = (int16_t) (n->split_ratio * ((n->split_dir == DIR_UP || n->split_dir == DIR_DOWN) ? height : width));
-		presel_rectangles = malloc(2 * sizeof(xcb_rectangle_t));
-		switch (n->split_dir) {
-			case DIR_UP:
-				presel_rectangles[0] = (xcb_rectangle_t) {width, 0, 2 * border_width, fence};
-				presel_rectangles[1] = (xcb_rectangle_t) {0, height + border_width, full_width, border_width};
-				break;
-			case DIR_DOWN:
-				presel_rectangles[0] = (xcb_rectangle_t) {width, fence + 1, 2 * border_width, height + border_width - (fence + 1)};
-				presel_rectangles[1] = (xcb_rectangle_t) {0, height, full_width, border_width};
-				break;
-			case DIR_LEFT:
-				presel_rectangles[0] = (xcb_rectangle_t) {0, height, fence, 2 * border_width};
-				presel_rectangles[1] = (xcb_rectangle_t) {width + border_width, 0, border_width, full_height};
-				break;
-			case DIR_RIGHT:
-				presel_rectangles[0] = (xcb_rectangle_t) {fence + 1, height, width + border_width - (fence + 1), 2 * border_width};
-				presel_rectangles[1] = (xcb_rectangle_t) {width, 0, border_width, full_height};
-				break;
+/* Schedules a redraw of the border of the given node for the commit phase */
+void invalidate_border(node_t *n)
+{
+	if (n == NULL || n->client->border_dirty)
+		return;
+	if (dirty_borders_len == dirty_borders_cap) {
+		unsigned int cap = (dirty_borders_cap == 0 ? 16 : 2 * dirty_borders_cap);
+		xcb_window_t *wins = realloc(dirty_borders, cap * sizeof(xcb_window_t));
+		if (wins == NULL) {
+			warn("Couldn't grow the dirty borders list.\n");
+			return;
 		}
-		xcb_change_gc(dpy, gc, XCB_GC_FOREGROUND, &presel_border_color_pxl);
-		xcb_poly_fill_rectangle(dpy, pixmap, gc, 2, presel_rectangles);
-		xcb_change_window_attributes(dpy, win, XCB_CW_BORDER_PIXMAP, &pixmap);
-		free(presel_rectangles);
-		xcb_free_gc(dpy, gc);
-		xcb_free_pixmap(dpy, pixmap);
+		dirty_borders = wins;
+		dirty_borders_cap = cap;
+	}
+	n->client->border_dirty = true;
+	dirty_borders[dirty_borders_len++] = n->client->window;
+}
+
+void commit_borders(void)
+{
+	for (unsigned int i = 0; i < dirty_borders_len; i++) {
+		coordinates_t loc;
+		if (!locate_window(dirty_borders[i], &loc) || !loc.node->client->border_dirty)
+			continue;
+		loc.node->client->border_dirty = false;
+		window_draw_border(loc.node, loc.desktop->focus == loc.node, mon == loc.monitor);
 	}
+	dirty_borders_len = 0;
 }
 
 pointer_state_t *make_pointer_state(void)
@@ -346,12 +535,22 @@ void adopt_orphans(void)
 
 	int len = xcb_query_tree_children_length(qtr);
 	xcb_window_t *wins = xcb_query_tree_children(qtr);
+	xcb_get_property_cookie_t *cookies = malloc(len * sizeof(xcb_get_property_cookie_t));
+	if (cookies == NULL) {
+		free(qtr);
+		return;
+	}
+	for (int i = 0; i < len; i++)
+		cookies[i] = xcb_ewmh_get_wm_desktop(ewmh, wins[i]);
 	for (int i = 0; i < len; i++) {
 		uint32_t idx;
-		xcb_window_t win = wins[i];
-		if (xcb_ewmh_get_wm_desktop_reply(ewmh, xcb_ewmh_get_wm_desktop(ewmh, win), &idx, NULL) == 1)
-			schedule_window(win);
+		if (xcb_ewmh_get_wm_desktop_reply(ewmh, cookies[i], &idx, NULL) == 1)
+			prefetch_window(wins[i]);
 	}
+	while (prefetch_head != NULL)
+		schedule_window(prefetch_head->win);
+
+	free(cookies);
 
 	free(qtr);
 }
@@ -374,7 +573,7 @@ void window_kill(monitor_t *m, desktop_t *d, node_t *n)
 	xcb_window_t win = n->client->window;
 	PRINTF("kill window %X\n", win);
 
-	xcb_kill_client(dpy, win);
+	backend->kill_client(win);
 	remove_node(m, d, n);
 }
 
@@ -389,6 +588,7 @@ void set_fullscreen(node_t *n, bool value)
 	put_status(SBSC_MASK_WINDOW_STATE, "window_state fullscreen %s 0x%X\n", ONOFFSTR(value), c->window);
 
 	c->fullscreen = value;
+	invalidate_layout(n);
 	if (value)
 		ewmh_wm_state_add(c, ewmh->_NET_WM_STATE_FULLSCREEN);
 	else
@@ -407,6 +607,7 @@ void set_pseudo_tiled(node_t *n, bool value)
 	put_status(SBSC_MASK_WINDOW_STATE, "window_state pseudo_tiled %s 0x%X\n", ONOFFSTR(value), c->window);
 
 	c->pseudo_tiled = value;
+	invalidate_layout(n);
 }
 
 void set_floating(node_t *n, bool value)
@@ -422,6 +623,7 @@ void set_floating(node_t *n, bool value)
 	n->split_mode = MODE_AUTOMATIC;
 	c->floating = n->vacant = value;
 	update_vacant_state(n->parent);
+	invalidate_layout(n);
 
 	if (value) {
 		enable_floating_atom(c->window);
@@ -434,7 +636,7 @@ void set_floating(node_t *n, bool value)
 	stack(n, STACK_ABOVE);
 }
 
-void set_locked(monitor_t *m, desktop_t *d, node_t *n, bool value)
+void set_locked(node_t *n, bool value)
 {
 	if (n == NULL || n->client->locked == value)
 		return;
@@ -445,7 +647,7 @@ void set_locked(monitor_t *m, desktop_t *d, node_t *n, bool value)
 	put_status(SBSC_MASK_WINDOW_STATE, "window_state locked %s 0x%X\n", ONOFFSTR(value), c->window);
 
 	c->locked = value;
-	window_draw_border(n, d->focus == n, m == mon);
+	invalidate_border(n);
 }
 
 void set_sticky(monitor_t *m, desktop_t *d, node_t *n, bool value)
@@ -470,10 +672,10 @@ void set_sticky(monitor_t *m, desktop_t *d, node_t *n, bool value)
 		m->num_sticky--;
 	}
 
-	window_draw_border(n, d->focus == n, m == mon);
+	invalidate_border(n);
 }
 
-void set_private(monitor_t *m, desktop_t *d, node_t *n, bool value)
+void set_private(node_t *n, bool value)
 {
 	if (n == NULL || n->client->private == value)
 		return;
@@ -485,15 +687,17 @@ void set_private(monitor_t *m, desktop_t *d, node_t *n, bool value)
 
 	c->private = value;
 	update_privacy_level(n, value);
-	window_draw_border(n, d->focus == n, m == mon);
+	invalidate_border(n);
 }
 
-void set_urgency(monitor_t *m, desktop_t *d, node_t *n, bool value)
+void set_urgency(desktop_t *d, node_t *n, bool value)
 {
 	if (value && mon->desk->focus == n)
 		return;
+	if (n->client->urgent != value)
+		d->urgent_count += (value ? 1 : -1);
 	n->client->urgent = value;
-	window_draw_border(n, d->focus == n, m == mon);
+	invalidate_border(n);
 
 	put_status(SBSC_MASK_WINDOW_STATE, "window_state urgent %s 0x%X\n", ONOFFSTR(value), n->client->window);
 	put_status(SBSC_MASK_REPORT);
@@ -516,6 +720,156 @@ void disable_floating_atom(xcb_window_t win)
 	set_floating_atom(win, 0);
 }
 
+color_t *find_color(char *col, xcb_colormap_t map)
+{
+	for (color_t *c = color_head; c != NULL; c = c->next)
+		if (c->colormap == map && streq(c->name, col))
+			return c;
+	return NULL;
+}
+
+color_t *add_color(char *col, xcb_colormap_t map)
+{
+	color_t *c = malloc(sizeof(color_t));
+	snprintf(c->name, sizeof(c->name), "%s", col);
+	c->colormap = map;
+	c->pixel = 0;
+	c->valid = false;
+	c->next = color_head;
+	color_head = c;
+	return c;
+}
+
+/* Allocates the given colors that aren't cached yet: every request is sent
+ * before the first reply is awaited */
+void cache_colors(char **cols, unsigned int len, xcb_colormap_t map)
+{
+	if (map == XCB_NONE)
+		map = screen->default_colormap;
+
+	color_t *entries[len];
+	xcb_alloc_color_cookie_t rgb_cookies[len];
+	xcb_alloc_named_color_cookie_t named_cookies[len];
+
+	for (unsigned int i = 0; i < len; i++) {
+		entries[i] = NULL;
+		char *col = cols[i];
+		if (find_color(col, map) != NULL)
+			continue;
+		entries[i] = add_color(col, map);
+		rgb_cookies[i].sequence = named_cookies[i].sequence = 0;
+		if (col[0] == '#') {
+			unsigned int red, green, blue;
+			if (sscanf(col + 1, "%02x%02x%02x", &red, &green, &blue) == 3) {
+				/* 2**16 - 1 == 0xffff and 0x101 * 0xij == 0xijij */
+				red *= 0x101;
+				green *= 0x101;
+				blue *= 0x101;
+				rgb_cookies[i] = xcb_alloc_color(dpy, map, red, green, blue);
+			}
+		} else {
+			named_cookies[i] = xcb_alloc_named_color(dpy, map, strlen(col), col);
+		}
+	}
+
+	for (unsigned int i = 0; i < len; i++) {
+		color_t *c = entries[i];
+		if (c == NULL)
+			continue;
+		if (rgb_cookies[i].sequence != 0) {
+			xcb_alloc_color_reply_t *reply = xcb_alloc_color_reply(dpy, rgb_cookies[i], NULL);
+			if (reply != NULL) {
+				c->pixel = reply->pixel;
+				c->valid = true;
+				free(reply);
+			}
+		} else if (named_cookies[i].sequence != 0) {
+			xcb_alloc_named_color_reply_t *reply = xcb_alloc_named_color_reply(dpy, named_cookies[i], NULL);
+			if (reply != NULL) {
+				c->pixel = reply->pixel;
+				c->valid = true;
+				free(reply);
+			}
+		}
+	}
+}
+
+bool get_color(char *col, xcb_colormap_t map, uint32_t *pxl)
+{
+	if (map == XCB_NONE)
+		map = screen->default_colormap;
+
+	color_t *c = find_color(col, map);
+	if (c == NULL) {
+		cache_colors(&col, 1, map);
+		c = find_color(col, map);
+	}
+
+	if (c != NULL && c->valid) {
+		*pxl = c->pixel;
+		return true;
+	}
+	*pxl = 0;
+	return false;
+}
+
+void empty_colors(void)
+{
+	while (color_head != NULL) {
+		color_t *next = color_head->next;
+		free(color_head);
+		color_head = next;
+	}
+}
+
+#define BORDER_COLORS { \
+		focused_border_color, active_border_color, normal_border_color, \
+		presel_border_color, urgent_border_color, \
+		focused_locked_border_color, active_locked_border_color, normal_locked_border_color, \
+		focused_sticky_border_color, active_sticky_border_color, normal_sticky_border_color, \
+		focused_private_border_color, active_private_border_color, normal_private_border_color \
+	}
+
+/* Allocates every border color in the given colormap at once */
+void cache_border_colors(xcb_colormap_t map)
+{
+	char *cols[] = BORDER_COLORS;
+	cache_colors(cols, LENGTH(cols), map);
+}
+
+/* Called once a color setting went from `old` to `col`: the new color is
+ * allocated in every colormap seen so far, and the old one is released
+ * unless another setting still uses it */
+void update_color(char *old, char *col)
+{
+	cache_colors(&col, 1, screen->default_colormap);
+	for (color_t *c = color_head; c != NULL; c = c->next) {
+		bool seen = false;
+		for (color_t *d = color_head; d != c && !seen; d = d->next)
+			seen = (d->colormap == c->colormap);
+		if (!seen)
+			cache_colors(&col, 1, c->colormap);
+	}
+
+	char *cols[] = BORDER_COLORS;
+	for (unsigned int i = 0; i < LENGTH(cols); i++)
+		if (streq(cols[i], old))
+			return;
+
+	color_t **p = &color_head;
+	while (*p != NULL) {
+		color_t *c = *p;
+		if (streq(c->name, old)) {
+			if (c->valid)
+				backend->free_colors(c->colormap, 1, &c->pixel);
+			*p = c->next;
+			free(c);
+		} else {
+			p = &c->next;
+		}
+	}
+}
+
 uint32_t get_border_color(client_t *c, bool focused_window, bool focused_monitor)
 {
 	if (c == NULL)
@@ -525,35 +879,35 @@ uint32_t get_border_color(client_t *c, bool focused_window, bool focused_monitor
 
 	if (focused_monitor && focused_window) {
 		if (c->locked)
-			get_color(focused_locked_border_color, c->window, &pxl);
+			get_color(focused_locked_border_color, c->colormap, &pxl);
 		else if (c->sticky)
-			get_color(focused_sticky_border_color, c->window, &pxl);
+			get_color(focused_sticky_border_color, c->colormap, &pxl);
 		else if (c->private)
-			get_color(focused_private_border_color, c->window, &pxl);
+			get_color(focused_private_border_color, c->colormap, &pxl);
 		else
-			get_color(focused_border_color, c->window, &pxl);
+			get_color(focused_border_color, c->colormap, &pxl);
 	} else if (focused_window) {
 		if (c->urgent)
-			get_color(urgent_border_color, c->window, &pxl);
+			get_color(urgent_border_color, c->colormap, &pxl);
 		else if (c->locked)
-			get_color(active_locked_border_color, c->window, &pxl);
+			get_color(active_locked_border_color, c->colormap, &pxl);
 		else if (c->sticky)
-			get_color(active_sticky_border_color, c->window, &pxl);
+			get_color(active_sticky_border_color, c->colormap, &pxl);
 		else if (c->private)
-			get_color(active_private_border_color, c->window, &pxl);
+			get_color(active_private_border_color, c->colormap, &pxl);
 		else
-			get_color(active_border_color, c->window, &pxl);
+			get_color(active_border_color, c->colormap, &pxl);
 	} else {
 		if (c->urgent)
-			get_color(urgent_border_color, c->window, &pxl);
+			get_color(urgent_border_color, c->colormap, &pxl);
 		else if (c->locked)
-			get_color(normal_locked_border_color, c->window, &pxl);
+			get_color(normal_locked_border_color, c->colormap, &pxl);
 		else if (c->sticky)
-			get_color(normal_sticky_border_color, c->window, &pxl);
+			get_color(normal_sticky_border_color, c->colormap, &pxl);
 		else if (c->private)
-			get_color(normal_private_border_color, c->window, &pxl);
+			get_color(normal_private_border_color, c->colormap, &pxl);
 		else
-			get_color(normal_border_color, c->window, &pxl);
+			get_color(normal_border_color, c->colormap, &pxl);
 	}
 
 	return pxl;
@@ -612,34 +966,76 @@ void query_pointer(xcb_window_t *win, xcb_point_t *pt)
 	window_raise(motion_recorder);
 }
 
-void window_border_width(xcb_window_t win, uint32_t bw)
+void window_resize(xcb_window_t win, uint16_t w, uint16_t h)
 {
-	uint32_t values[] = {bw};
-	xcb_configure_window(dpy, win, XCB_CONFIG_WINDOW_BORDER_WIDTH, values);
+	uint32_t values[] = {w, h};
+	backend->configure_window(win, XCB_CONFIG_WINDOW_WIDTH_HEIGHT, values);
 }
 
-void window_move(xcb_window_t win, int16_t x, int16_t y)
+void window_move_resize(xcb_window_t win, int16_t x, int16_t y, uint16_t w, uint16_t h)
 {
-	uint32_t values[] = {x, y};
-	xcb_configure_window(dpy, win, XCB_CONFIG_WINDOW_X_Y, values);
+	uint32_t values[] = {x, y, w, h};
+	backend->configure_window(win, XCB_CONFIG_WINDOW_X_Y_WIDTH_HEIGHT, values);
 }
 
-void window_resize(xcb_window_t win, uint16_t w, uint16_t h)
+/* Sends, in a single request, the parts of the given geometry and border
+ * width that differ from what was last sent for the window of the client */
+void window_configure(client_t *c, xcb_rectangle_t r, unsigned int bw)
 {
-	uint32_t values[] = {w, h};
-	xcb_configure_window(dpy, win, XCB_CONFIG_WINDOW_WIDTH_HEIGHT, values);
+	xcb_rectangle_t *s = &c->sent_rectangle;
+	bool known = (s->width != 0);
+	uint16_t mask = 0;
+	uint32_t values[5];
+	unsigned short i = 0;
+
+	if (!known || s->x != r.x) {
+		mask |= XCB_CONFIG_WINDOW_X;
+		values[i++] = r.x;
+	}
+	if (!known || s->y != r.y) {
+		mask |= XCB_CONFIG_WINDOW_Y;
+		values[i++] = r.y;
+	}
+	if (!known || s->width != r.width) {
+		mask |= XCB_CONFIG_WINDOW_WIDTH;
+		values[i++] = r.width;
+	}
+	if (!known || s->height != r.height) {
+		mask |= XCB_CONFIG_WINDOW_HEIGHT;
+		values[i++] = r.height;
+	}
+	if (c->sent_border_width != (int) bw) {
+		mask |= XCB_CONFIG_WINDOW_BORDER_WIDTH;
+		values[i++] = bw;
+	}
+
+	if (mask == 0) {
+		suppressed_requests++;
+		return;
+	}
+
+	*s = r;
+	c->sent_border_width = bw;
+	backend->configure_window(c->window, mask, values);
 }
 
-void window_move_resize(xcb_window_t win, int16_t x, int16_t y, uint16_t w, uint16_t h)
+/* Changes the border attribute of the window of the given client unless it
+ * was the last one sent */
+void client_border_attribute(client_t *c, uint32_t mask, uint32_t value)
 {
-	uint32_t values[] = {x, y, w, h};
-	xcb_configure_window(dpy, win, XCB_CONFIG_WINDOW_X_Y_WIDTH_HEIGHT, values);
+	if (c->sent_border_mask == mask && c->sent_border_value == value) {
+		suppressed_requests++;
+		return;
+	}
+	c->sent_border_mask = mask;
+	c->sent_border_value = value;
+	backend->change_window_attributes(c->window, mask, &value);
 }
 
 void window_raise(xcb_window_t win)
 {
 	uint32_t values[] = {XCB_STACK_MODE_ABOVE};
-	xcb_configure_window(dpy, win, XCB_CONFIG_WINDOW_STACK_MODE, values);
+	backend->configure_window(win, XCB_CONFIG_WINDOW_STACK_MODE, values);
 }
 
 void window_center(monitor_t *m, client_t *c)
@@ -664,7 +1060,7 @@ void window_stack(xcb_window_t w1, xcb_window_t w2, uint32_t mode)
 		return;
 	uint16_t mask = XCB_CONFIG_WINDOW_SIBLING | XCB_CONFIG_WINDOW_STACK_MODE;
 	uint32_t values[] = {w2, mode};
-	xcb_configure_window(dpy, w1, mask, values);
+	backend->configure_window(w1, mask, values);
 }
 
 void window_above(xcb_window_t w1, xcb_window_t w2)
@@ -680,19 +1076,19 @@ void window_below(xcb_window_t w1, xcb_window_t w2)
 void window_lower(xcb_window_t win)
 {
 	uint32_t values[] = {XCB_STACK_MODE_BELOW};
-	xcb_configure_window(dpy, win, XCB_CONFIG_WINDOW_STACK_MODE, values);
+	backend->configure_window(win, XCB_CONFIG_WINDOW_STACK_MODE, values);
 }
 
 void window_set_visibility(xcb_window_t win, bool visible)
 {
 	uint32_t values_off[] = {ROOT_EVENT_MASK & ~XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY};
 	uint32_t values_on[] = {ROOT_EVENT_MASK};
-	xcb_change_window_attributes(dpy, root, XCB_CW_EVENT_MASK, values_off);
+	backend->change_window_attributes(root, XCB_CW_EVENT_MASK, values_off);
 	if (visible)
-		xcb_map_window(dpy, win);
+		backend->map_window(win);
 	else
-		xcb_unmap_window(dpy, win);
-	xcb_change_window_attributes(dpy, root, XCB_CW_EVENT_MASK, values_on);
+		backend->unmap_window(win);
+	backend->change_window_attributes(root, XCB_CW_EVENT_MASK, values_on);
 }
 
 void window_hide(xcb_window_t win)
@@ -756,13 +1152,13 @@ void set_input_focus(node_t *n)
 	} else {
 		if (n->client->icccm_focus)
 			send_client_message(n->client->window, ewmh->WM_PROTOCOLS, WM_TAKE_FOCUS);
-		xcb_set_input_focus(dpy, XCB_INPUT_FOCUS_POINTER_ROOT, n->client->window, XCB_CURRENT_TIME);
+		backend->set_input_focus(n->client->window);
 	}
 }
 
 void clear_input_focus(void)
 {
-	xcb_set_input_focus(dpy, XCB_INPUT_FOCUS_POINTER_ROOT, root, XCB_CURRENT_TIME);
+	backend->set_input_focus(root);
 }
 
 void center_pointer(xcb_rectangle_t r)
@@ -770,7 +1166,7 @@ void center_pointer(xcb_rectangle_t r)
 	int16_t cx = r.x + r.width / 2;
 	int16_t cy = r.y + r.height / 2;
 	window_lower(motion_recorder);
-	xcb_warp_pointer(dpy, XCB_NONE, root, 0, 0, 0, 0, cx, cy);
+	backend->warp_pointer(cx, cy);
 	window_raise(motion_recorder);
 }
 
@@ -786,7 +1182,7 @@ void get_atom(char *name, xcb_atom_t *atom)
 
 void set_atom(xcb_window_t win, xcb_atom_t atom, uint32_t value)
 {
-	xcb_change_property(dpy, XCB_PROP_MODE_REPLACE, win, atom, XCB_ATOM_CARDINAL, 32, 1, &value);
+	backend->change_property(win, atom, XCB_ATOM_CARDINAL, 32, 1, &value);
 }
 
 bool has_proto(xcb_atom_t atom, xcb_icccm_get_wm_protocols_reply_t *protocols)
@@ -809,5 +1205,5 @@ void send_client_message(xcb_window_t win, xcb_atom_t property, xcb_atom_t value
 	e.data.data32[0] = value;
 	e.data.data32[1] = XCB_CURRENT_TIME;
 
-	xcb_send_event(dpy, false, win, XCB_EVENT_MASK_NO_EVENT, (char *) &e);
+	backend->send_event(win, XCB_EVENT_MASK_NO_EVENT, (char *) &e);
 }
@@ -31,10 +31,22 @@
 #include <xcb/xcb_icccm.h>
 #include "types.h"
 
+prefetch_t *make_prefetch(xcb_window_t win);
+void prefetch_window(xcb_window_t win);
+prefetch_t *take_prefetch(xcb_window_t win);
+void unlink_prefetch(prefetch_t *pf);
+void free_prefetch(prefetch_t *pf);
+void remove_prefetch(prefetch_t *pf);
 void schedule_window(xcb_window_t win);
-void manage_window(xcb_window_t win, rule_consequence_t *csq, int fd);
+void manage_window(xcb_window_t win, rule_consequence_t *csq);
 void unmanage_window(xcb_window_t win);
 void window_draw_border(node_t *n, bool focused_window, bool focused_monitor);
+xcb_pixmap_t make_presel_pixmap(xcb_window_t win, uint8_t depth, border_pixmap_t *bp);
+void free_presel_pixmap(client_t *c);
+xcb_gcontext_t get_gc(uint8_t depth, xcb_drawable_t d);
+void empty_gcs(void);
+void invalidate_border(node_t *n);
+void commit_borders(void);
 pointer_state_t *make_pointer_state(void);
 bool contains(xcb_rectangle_t a, xcb_rectangle_t b);
 xcb_rectangle_t get_rectangle(client_t *c);
@@ -45,23 +57,30 @@ void window_kill(monitor_t *m, desktop_t *d, node_t *n);
 void set_fullscreen(node_t *n, bool value);
 void set_pseudo_tiled(node_t *n, bool value);
 void set_floating(node_t *n, bool value);
-void set_locked(monitor_t *m, desktop_t *d, node_t *n, bool value);
+void set_locked(node_t *n, bool value);
 void set_sticky(monitor_t *m, desktop_t *d, node_t *n, bool value);
-void set_private(monitor_t *m, desktop_t *d, node_t *n, bool value);
-void set_urgency(monitor_t *m, desktop_t *d, node_t *n, bool value);
+void set_private(node_t *n, bool value);
+void set_urgency(desktop_t *d, node_t *n, bool value);
 void set_floating_atom(xcb_window_t win, uint32_t value);
 void enable_floating_atom(xcb_window_t win);
 void disable_floating_atom(xcb_window_t win);
+color_t *find_color(char *col, xcb_colormap_t map);
+color_t *add_color(char *col, xcb_colormap_t map);
+void cache_colors(char **cols, unsigned int len, xcb_colormap_t map);
+bool get_color(char *col, xcb_colormap_t map, uint32_t *pxl);
+void empty_colors(void);
+void cache_border_colors(xcb_colormap_t map);
+void update_color(char *old, char *col);
 uint32_t get_border_color(client_t *c, bool focused_window, bool focused_monitor);
 void update_floating_rectangle(client_t *c);
 void restrain_floating_width(client_t *c, int *width);
 void restrain_floating_height(client_t *c, int *height);
 void restrain_floating_size(client_t *c, int *width, int *height);
 void query_pointer(xcb_window_t *win, xcb_point_t *pt);
-void window_border_width(xcb_window_t win, uint32_t bw);
-void window_move(xcb_window_t win, int16_t x, int16_t y);
 void window_resize(xcb_window_t win, uint16_t w, uint16_t h);
 void window_move_resize(xcb_window_t win, int16_t x, int16_t y, uint16_t w, uint16_t h);
+void window_configure(client_t *c, xcb_rectangle_t r, unsigned int bw);
+void client_border_attribute(client_t *c, uint32_t mask, uint32_t value);
 void window_raise(xcb_window_t win);
 void window_center(monitor_t *m, client_t *c);
 void window_stack(xcb_window_t w1, xcb_window_t w2, uint32_t mode);
@@ -0,0 +1,175 @@
+/* Copyright (c) 2012, Bastien Dejean
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include "bspwm.h"
+#include "wintable.h"
+
+/* Window identifiers are allocated sequentially inside each client's resource
+ * range, mix the bits so that neighbouring ids don't share a bucket chain */
+unsigned int wintable_hash(xcb_window_t win)
+{
+	uint32_t h = win;
+	h ^= h >> 16;
+	h *= 0x45d9f3b;
+	h ^= h >> 16;
+	return h & (wintable_size - 1);
+}
+
+window_entry_t *make_window_entry(xcb_window_t win)
+{
+	window_entry_t *we = malloc(sizeof(window_entry_t));
+	we->win = win;
+	we->node = NULL;
+	we->desktop = NULL;
+	we->rule = NULL;
+	we->next = NULL;
+	return we;
+}
+
+void wintable_grow(void)
+{
+	unsigned int size = (wintable_size == 0 ? WINTABLE_MIN_SIZE : 2 * wintable_size);
+	window_entry_t **table = calloc(size, sizeof(window_entry_t *));
+	if (table == NULL) {
+		warn("Couldn't grow the window table.\n");
+		return;
+	}
+	window_entry_t **old = wintable;
+	unsigned int old_size = wintable_size;
+	wintable = table;
+	wintable_size = size;
+	for (unsigned int i = 0; i < old_size; i++) {
+		window_entry_t *we = old[i];
+		while (we != NULL) {
+			window_entry_t *next = we->next;
+			unsigned int h = wintable_hash(we->win);
+			we->next = wintable[h];
+			wintable[h] = we;
+			we = next;
+		}
+	}
+	free(old);
+}
+
+window_entry_t *wintable_find(xcb_window_t win)
+{
+	if (wintable_size == 0)
+		return NULL;
+	for (window_entry_t *we = wintable[wintable_hash(win)]; we != NULL; we = we->next)
+		if (we->win == win)
+			return we;
+	return NULL;
+}
+
+window_entry_t *wintable_get(xcb_window_t win)
+{
+	window_entry_t *we = wintable_find(win);
+	if (we != NULL)
+		return we;
+	if (wintable_count >= wintable_size)
+		wintable_grow();
+	if (wintable_size == 0)
+		return NULL;
+	we = make_window_entry(win);
+	unsigned int h = wintable_hash(win);
+	we->next = wintable[h];
+	wintable[h] = we;
+	wintable_count++;
+	return we;
+}
+
+/* Drops the entry of the given window once it no longer refers to anything */
+void wintable_release(xcb_window_t win)
+{
+	if (wintable_size == 0)
+		return;
+	window_entry_t **p = &wintable[wintable_hash(win)];
+	while (*p != NULL) {
+		window_entry_t *we = *p;
+		if (we->win == win) {
+			if (we->node == NULL && we->rule == NULL) {
+				*p = we->next;
+				free(we);
+				wintable_count--;
+			}
+			return;
+		}
+		p = &we->next;
+	}
+}
+
+void wintable_add_node(desktop_t *d, node_t *n)
+{
+	if (n == NULL || n->client == NULL)
+		return;
+	window_entry_t *we = wintable_get(n->client->window);
+	if (we == NULL)
+		return;
+	we->node = n;
+	we->desktop = d;
+}
+
+void wintable_remove_node(node_t *n)
+{
+	if (n == NULL || n->client == NULL)
+		return;
+	window_entry_t *we = wintable_find(n->client->window);
+	if (we == NULL || we->node != n)
+		return;
+	we->node = NULL;
+	we->desktop = NULL;
+	wintable_release(we->win);
+}
+
+void wintable_add_rule(pending_rule_t *pr)
+{
+	window_entry_t *we = wintable_get(pr->win);
+	if (we != NULL)
+		we->rule = pr;
+}
+
+void wintable_remove_rule(pending_rule_t *pr)
+{
+	window_entry_t *we = wintable_find(pr->win);
+	if (we == NULL || we->rule != pr)
+		return;
+	we->rule = NULL;
+	wintable_release(we->win);
+}
+
+void empty_wintable(void)
+{
+	for (unsigned int i = 0; i < wintable_size; i++) {
+		window_entry_t *we = wintable[i];
+		while (we != NULL) {
+			window_entry_t *next = we->next;
+			free(we);
+			we = next;
+		}
+	}
+	free(wintable);
+	wintable = NULL;
+	wintable_size = wintable_count = 0;
+}